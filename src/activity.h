@@ -0,0 +1,425 @@
+#ifndef __ACTIVITY_H__
+#define __ACTIVITY_H__
+
+
+#include "memory.h"
+#include "jobs.h"
+#include "stats.h"
+#include "entities.h"
+#include "movers.h"
+
+
+// Activity.
+//
+// A level is cut into horizontal regions of ACTIVITY_REGION_H units, and every entity
+// is listed in the regions it can reach: a mover wherever its path goes, anything
+// else where it stands. Every tick the caller wakes the regions around whatever is
+// looking, the camera and the cat, and only their entities are updated; the rest are
+// flagged EF_ASLEEP and skipped by the update, the cat's collisions and drawing. A
+// tick costs what the awake regions hold, however tall the level.
+//
+// Nothing is lost while asleep. Movers are a function of level time, so one evaluation
+// puts them back on their path. Anything else catches up in a single step over the
+// time it slept, which Entity::Update does exactly for constant acceleration. Entities
+// that move on their own, like the cat, are updated every tick wherever they are.
+//
+// Entities are kept by pool slot, so they survive the pool's swap-removes. Each is
+// linked into one list, the region its extent starts in or the always-awake one, and
+// a region's entities are those listed up to span_max regions above it that reach
+// down to it. Spawning and despawning link and unlink; whatever was updated in a tick
+// is listed again by the next, where it stands now or as always awake once it moves.
+// Whoever moves a sleeping entity by hand calls ActivityMove.
+//
+// Distant regions can also be brought up to date at a reduced rate: with
+// distant_every N, each tick one in N of the sleeping regions is, in turn.
+
+
+#define ACTIVITY_REGION_H (256.0f * SPRITE_SCALE)
+#define ACTIVITY_WAKE_MARGIN (64.0f * SPRITE_SCALE) // around what wakes, for what is about to come into view
+#define ACTIVITY_ALWAYS -1 // lo of an entity updated every tick
+#define ACTIVITY_UNLISTED -2 // lo of a free slot
+#define ACTIVITY_END 0xFFFFFFFF
+
+struct ActivityRegions {
+    f32 y0;
+    s32 cnt;
+    u32 slot_cnt; // of the pool the regions were built for
+
+    // per region, the first slot listed there; per slot, the regions its entity
+    // spans and the links of its list
+    u32 *head;
+    u32 always_head;
+    s32 *lo;
+    s32 *hi;
+    u32 *next;
+    u32 *prev;
+    s32 span_max; // the most any listed entity reaches below its first region
+
+    u64 tick;
+    u64 *awake_tick; // per region, the last tick it was awake
+    u32 *awake; // regions awake this tick
+    u32 awake_cnt;
+    u32 *awake_prev;
+    u32 awake_prev_cnt;
+
+    u64 *done_tick; // per slot, the last tick it was updated
+    f64 *synced; // per slot, the level time it is integrated to
+    u32 *active; // slots to integrate this tick
+    u32 active_cnt;
+    f64 time; // of the last update
+
+    s32 distant_every; // 0 leaves distant regions asleep
+};
+
+s32 ActivityRegion(ActivityRegions *act, f32 y) {
+    s32 r = (s32) floorf((y - act->y0) / ACTIVITY_REGION_H);
+    return r < 0 ? 0 : (r >= act->cnt ? act->cnt - 1 : r);
+}
+
+Entity *ActivityEntity(Pool<Entity> *entities, u32 slot) {
+    return entities->arr + entities->slot_to_dense[slot];
+}
+
+// the vertical extent an entity can be in, from its rects at both ends of its path
+void ActivityEntityExtent(MoverSet *movers, const Entity *ent, f32 *y_lo, f32 *y_hi) {
+    Vector2 lo = ent->anchor;
+    Vector2 hi = ent->anchor;
+    if (ent->flags & EF_KINEMATIC) {
+        MoverPathBounds(movers, ent->mover_idx, &lo, &hi);
+    }
+    f32 top = ent->ani_offset.y < ent->coll_offset.y ? ent->ani_offset.y : ent->coll_offset.y;
+    f32 bottom = ent->ani_offset.y + ent->ani_rect.height;
+    bottom = ent->coll_offset.y + ent->coll_rect.height > bottom ? ent->coll_offset.y + ent->coll_rect.height : bottom;
+    *y_lo = lo.y + top;
+    *y_hi = hi.y + bottom;
+}
+
+bool ActivityAlwaysAwake(const Entity *ent) {
+    if (ent->flags & EF_KINEMATIC) {
+        return false;
+    }
+    bool moving = ent->velocity.x != 0 || ent->velocity.y != 0 || ent->accel.x != 0 || ent->accel.y != 0;
+    return ent->tpe == ET_CAT || moving;
+}
+
+bool ActivityEntityAwake(ActivityRegions *act, u32 slot) {
+    for (s32 r = act->lo[slot]; r <= act->hi[slot]; ++r) {
+        if (act->awake_tick[r] == act->tick) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// asleep unless always awake or in a region awake this tick
+void ActivitySetAsleep(ActivityRegions *act, Entity *ent, u32 slot) {
+    if (act->lo[slot] >= 0 && ActivityEntityAwake(act, slot) == false) {
+        ent->flags |= EF_ASLEEP;
+    }
+    else {
+        ent->flags &= ~EF_ASLEEP;
+    }
+}
+
+// whether the entity in slot is one of region r's
+bool ActivityInRegion(ActivityRegions *act, u32 slot, s32 r) {
+    return act->lo[slot] <= r && act->hi[slot] >= r;
+}
+
+// the first region whose list can hold entities reaching down to r
+s32 ActivityFirstList(ActivityRegions *act, s32 r) {
+    return r - act->span_max > 0 ? r - act->span_max : 0;
+}
+
+
+// lists
+
+void ActivityUnlink(ActivityRegions *act, u32 slot) {
+    u32 next = act->next[slot];
+    u32 prev = act->prev[slot];
+    if (prev != ACTIVITY_END) {
+        act->next[prev] = next;
+    }
+    else if (act->lo[slot] == ACTIVITY_ALWAYS) {
+        act->always_head = next;
+    }
+    else {
+        act->head[act->lo[slot]] = next;
+    }
+    if (next != ACTIVITY_END) {
+        act->prev[next] = prev;
+    }
+    act->lo[slot] = act->hi[slot] = ACTIVITY_UNLISTED;
+}
+
+// lists the entity where it is now, as always awake if it moves on its own
+void ActivityLink(ActivityRegions *act, MoverSet *movers, const Entity *ent, u32 slot) {
+    s32 lo = ACTIVITY_ALWAYS;
+    s32 hi = ACTIVITY_ALWAYS;
+    if (ActivityAlwaysAwake(ent) == false) {
+        f32 y_lo, y_hi;
+        ActivityEntityExtent(movers, ent, &y_lo, &y_hi);
+        lo = ActivityRegion(act, y_lo);
+        hi = ActivityRegion(act, y_hi);
+        act->span_max = hi - lo > act->span_max ? hi - lo : act->span_max;
+    }
+
+    u32 *head = lo == ACTIVITY_ALWAYS ? &act->always_head : act->head + lo;
+    act->lo[slot] = lo;
+    act->hi[slot] = hi;
+    act->prev[slot] = ACTIVITY_END;
+    act->next[slot] = *head;
+    if (*head != ACTIVITY_END) {
+        act->prev[*head] = slot;
+    }
+    *head = slot;
+}
+
+// lists the entity again if it moved out of its regions, or started or stopped
+// moving; asleep after unless a region it is in now is awake
+void ActivityRelink(ActivityRegions *act, MoverSet *movers, Entity *ent, u32 slot) {
+    s32 lo = act->lo[slot];
+    s32 hi = act->hi[slot];
+    bool always = ActivityAlwaysAwake(ent);
+    if (always && lo == ACTIVITY_ALWAYS) {
+        return;
+    }
+    if (always == false && lo >= 0) {
+        f32 y_lo, y_hi;
+        ActivityEntityExtent(movers, ent, &y_lo, &y_hi);
+        if (ActivityRegion(act, y_lo) == lo && ActivityRegion(act, y_hi) == hi) {
+            return;
+        }
+    }
+
+    ActivityUnlink(act, slot);
+    ActivityLink(act, movers, ent, slot);
+    ActivitySetAsleep(act, ent, slot);
+}
+
+// after spawning h into the pool; the entity is taken as up to date at the last update
+void ActivityAdd(ActivityRegions *act, MoverSet *movers, Pool<Entity> *entities, Handle h) {
+    Entity *ent = entities->Get(h);
+    assert(ent != NULL);
+    act->done_tick[h.idx] = 0;
+    act->synced[h.idx] = act->time;
+    ActivityLink(act, movers, ent, h.idx);
+    ActivitySetAsleep(act, ent, h.idx);
+}
+
+// before despawning h from the pool
+void ActivityRemove(ActivityRegions *act, Handle h) {
+    if (act->lo[h.idx] != ACTIVITY_UNLISTED) {
+        ActivityUnlink(act, h.idx);
+    }
+}
+
+// after moving an entity by hand, or setting it moving or stopping it; the update
+// does this itself for whatever it updated
+void ActivityMove(ActivityRegions *act, MoverSet *movers, Pool<Entity> *entities, Handle h) {
+    Entity *ent = entities->Get(h);
+    assert(ent != NULL);
+    ActivityRelink(act, movers, ent, h.idx);
+}
+
+
+// building
+
+// for the pool's entities as they are now, with room for every slot it has
+ActivityRegions BuildActivityRegions(MArena *a, MoverSet *movers, Pool<Entity> *entities) {
+    ActivityRegions act = {};
+    u32 n = entities->cap;
+    act.slot_cnt = n;
+    act.lo = (s32*) ArenaAlloc(a, sizeof(s32) * n);
+    act.hi = (s32*) ArenaAlloc(a, sizeof(s32) * n);
+    act.next = (u32*) ArenaAlloc(a, sizeof(u32) * n);
+    act.prev = (u32*) ArenaAlloc(a, sizeof(u32) * n);
+    act.done_tick = (u64*) ArenaAlloc(a, sizeof(u64) * n);
+    act.synced = (f64*) ArenaAlloc(a, sizeof(f64) * n);
+    act.active = (u32*) ArenaAlloc(a, sizeof(u32) * n);
+    for (u32 slot = 0; slot < n; ++slot) {
+        act.lo[slot] = act.hi[slot] = ACTIVITY_UNLISTED;
+    }
+
+    f32 y_min = 0;
+    f32 y_max = 0;
+    bool any = false;
+    for (u32 i = 0; i < entities->len; ++i) {
+        if (ActivityAlwaysAwake(entities->arr + i)) {
+            continue;
+        }
+        f32 y_lo, y_hi;
+        ActivityEntityExtent(movers, entities->arr + i, &y_lo, &y_hi);
+        y_min = (any == false || y_lo < y_min) ? y_lo : y_min;
+        y_max = (any == false || y_hi > y_max) ? y_hi : y_max;
+        any = true;
+    }
+    act.y0 = floorf(y_min / ACTIVITY_REGION_H) * ACTIVITY_REGION_H;
+    act.cnt = (s32) ((y_max - act.y0) / ACTIVITY_REGION_H) + 1;
+
+    act.head = (u32*) ArenaAlloc(a, sizeof(u32) * act.cnt);
+    act.awake_tick = (u64*) ArenaAlloc(a, sizeof(u64) * act.cnt);
+    act.awake = (u32*) ArenaAlloc(a, sizeof(u32) * act.cnt);
+    act.awake_prev = (u32*) ArenaAlloc(a, sizeof(u32) * act.cnt);
+    for (s32 r = 0; r < act.cnt; ++r) {
+        act.head[r] = ACTIVITY_END;
+    }
+    act.always_head = ACTIVITY_END;
+
+    for (u32 i = 0; i < entities->len; ++i) {
+        ActivityLink(&act, movers, entities->arr + i, entities->dense_to_slot[i]);
+    }
+
+    return act;
+}
+
+// everything in the level just placed at time, listed again where it is; all regions
+// asleep until woken
+void ActivityReset(ActivityRegions *act, MoverSet *movers, Pool<Entity> *entities, f64 time) {
+    assert(entities->cap == act->slot_cnt);
+    act->tick = 1;
+    act->time = time;
+    memset(act->awake_tick, 0, sizeof(u64) * act->cnt);
+    act->awake_cnt = 0;
+    act->awake_prev_cnt = 0;
+    act->active_cnt = 0;
+    for (u32 i = 0; i < entities->len; ++i) {
+        u32 slot = entities->dense_to_slot[i];
+        act->done_tick[slot] = 0;
+        act->synced[slot] = time;
+        ActivityRelink(act, movers, entities->arr + i, slot);
+        ActivitySetAsleep(act, entities->arr + i, slot);
+    }
+}
+
+
+// per tick
+
+void ActivityBegin(ActivityRegions *act) {
+    u32 *prev = act->awake_prev;
+    act->awake_prev = act->awake;
+    act->awake_prev_cnt = act->awake_cnt;
+    act->awake = prev;
+    act->awake_cnt = 0;
+    act->tick++;
+}
+
+// wakes the regions from y_lo to y_hi, with a margin
+void ActivityWake(ActivityRegions *act, Pool<Entity> *entities, f32 y_lo, f32 y_hi) {
+    s32 r0 = ActivityRegion(act, y_lo - ACTIVITY_WAKE_MARGIN);
+    s32 r1 = ActivityRegion(act, y_hi + ACTIVITY_WAKE_MARGIN);
+    for (s32 r = r0; r <= r1; ++r) {
+        if (act->awake_tick[r] == act->tick) {
+            continue;
+        }
+        if (act->awake_tick[r] != act->tick - 1) {
+            for (s32 q = ActivityFirstList(act, r); q <= r; ++q) {
+                for (u32 slot = act->head[q]; slot != ACTIVITY_END; slot = act->next[slot]) {
+                    if (ActivityInRegion(act, slot, r)) {
+                        ActivityEntity(entities, slot)->flags &= ~EF_ASLEEP;
+                    }
+                }
+            }
+        }
+        act->awake_tick[r] = act->tick;
+        act->awake[act->awake_cnt++] = r;
+    }
+}
+
+// brings the entities of region r up to date: movers evaluated at time, the rest
+// listed for ActivityIntegrate
+void ActivityUpdateRegion(ActivityRegions *act, s32 r, MoverSet *movers, Pool<Entity> *entities, f64 time) {
+    for (s32 q = ActivityFirstList(act, r); q <= r; ++q) {
+        for (u32 slot = act->head[q]; slot != ACTIVITY_END; slot = act->next[slot]) {
+            if (ActivityInRegion(act, slot, r) == false || act->done_tick[slot] == act->tick) {
+                continue;
+            }
+            act->done_tick[slot] = act->tick;
+
+            Entity *ent = ActivityEntity(entities, slot);
+            if (ent->flags & EF_KINEMATIC) {
+                MoverEvalPath(movers, ent->mover_idx, time);
+                MoverApply(movers, ent);
+                STAT_INC(STAT_ENTITIES_UPDATED);
+            }
+            else if (ent->tpe != ET_UNKNOWN) {
+                act->active[act->active_cnt++] = slot;
+            }
+        }
+    }
+}
+
+// after waking: lists again what the last tick moved, puts what went to sleep to
+// sleep and brings the awake regions, and in turn the distant ones, up to date for
+// time. Replaces UpdateMovers for the tick.
+void ActivityUpdate(ActivityRegions *act, MoverSet *movers, Pool<Entity> *entities, f64 time) {
+    // slots despawned since are unlisted, and ones spawned into them are already
+    // where they belong
+    for (u32 k = 0; k < act->active_cnt; ++k) {
+        u32 slot = act->active[k];
+        if (act->lo[slot] != ACTIVITY_UNLISTED) {
+            ActivityRelink(act, movers, ActivityEntity(entities, slot), slot);
+        }
+    }
+
+    for (u32 k = 0; k < act->awake_prev_cnt; ++k) {
+        s32 r = act->awake_prev[k];
+        if (act->awake_tick[r] == act->tick) {
+            continue;
+        }
+        for (s32 q = ActivityFirstList(act, r); q <= r; ++q) {
+            for (u32 slot = act->head[q]; slot != ACTIVITY_END; slot = act->next[slot]) {
+                if (ActivityInRegion(act, slot, r) && ActivityEntityAwake(act, slot) == false) {
+                    ActivityEntity(entities, slot)->flags |= EF_ASLEEP;
+                }
+            }
+        }
+    }
+
+    act->time = time;
+    act->active_cnt = 0;
+    for (u32 slot = act->always_head; slot != ACTIVITY_END; slot = act->next[slot]) {
+        act->active[act->active_cnt++] = slot;
+    }
+    for (u32 k = 0; k < act->awake_cnt; ++k) {
+        ActivityUpdateRegion(act, act->awake[k], movers, entities, time);
+    }
+    if (act->distant_every > 0) {
+        for (s32 r = (s32) (act->tick % act->distant_every); r < act->cnt; r += act->distant_every) {
+            ActivityUpdateRegion(act, r, movers, entities, time);
+        }
+    }
+}
+
+struct ActivityIntegrateJob {
+    ActivityRegions *act;
+    Pool<Entity> *entities;
+    f64 time;
+    f32 dt;
+};
+
+void ActivityIntegrateRange(void *data, s32 lo, s32 hi) {
+    ActivityIntegrateJob *job = (ActivityIntegrateJob*) data;
+    ActivityRegions *act = job->act;
+    for (s32 k = lo; k < hi; ++k) {
+        u32 slot = act->active[k];
+        Entity *ent = ActivityEntity(job->entities, slot);
+
+        // what is always awake takes the tick's dt as is, the rest catch up on
+        // however long they slept
+        f32 dt = act->lo[slot] >= 0 ? (f32) (job->time - act->synced[slot]) : job->dt;
+        ent->Update(dt);
+        act->synced[slot] = job->time;
+    }
+}
+
+// integrates the entities ActivityUpdate listed up to time, dt being this tick's.
+// Replaces UpdateEntities for the tick.
+void ActivityIntegrate(ActivityRegions *act, JobSystem *jobs, Pool<Entity> *entities, f64 time, f32 dt) {
+    STAT_ADD(STAT_ENTITIES_UPDATED, act->active_cnt);
+    ActivityIntegrateJob job = { act, entities, time, dt };
+    ParallelFor(jobs, act->active_cnt, ENTITY_UPDATE_GRAIN, ActivityIntegrateRange, &job);
+}
+
+
+#endif
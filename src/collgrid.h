@@ -0,0 +1,226 @@
+#ifndef __COLLGRID_H__
+#define __COLLGRID_H__
+
+
+#include <cmath>
+
+#include "raylib.h"
+#include "memory.h"
+#include "jobs.h"
+#include "entities.h"
+
+
+// Collision grid.
+//
+// The column is rasterized at load time into cells of COLLGRID_CELL units, one u64 of
+// occupancy bits per row, separately for platforms and walls. A query turns the area
+// the cat sweeps this step into a row range and a column mask, so most steps are a
+// handful of AND tests, whatever the platform count. Rows that hit list the geometry
+// touching them (CSR: row_start[r] .. row_start[r + 1] into idx), and only those get
+// the exact tests.
+
+
+#define COLLGRID_CELL (4.0f * SPRITE_SCALE) // an eighth of a level grid cell
+#define COLLGRID_COLS 64
+#define COLLGRID_X0 (- 2 * COLLGRID_CELL)
+
+struct CollGridLayer {
+    u64 *bits;
+    u32 *row_start;
+    u32 *idx;
+};
+
+struct CollGrid {
+    f32 y0;
+    s32 rows;
+    CollGridLayer platforms;
+    CollGridLayer walls;
+};
+
+s32 CollGridCol(f32 x) {
+    s32 c = (s32) floorf((x - COLLGRID_X0) / COLLGRID_CELL);
+    return c < 0 ? 0 : (c >= COLLGRID_COLS ? COLLGRID_COLS - 1 : c);
+}
+
+s32 CollGridRow(CollGrid *grid, f32 y) {
+    return (s32) floorf((y - grid->y0) / COLLGRID_CELL);
+}
+
+// bits c0 through c1 inclusive
+u64 CollGridSpanMask(s32 c0, s32 c1) {
+    u64 ones = ~(u64) 0;
+    return (ones >> (63 - (c1 - c0))) << c0;
+}
+
+bool CollGridInLayer(const Entity &ent, bool walls) {
+    if (walls) {
+        return ent.tpe == ET_WALL_LEFT || ent.tpe == ET_WALL_RIGHT;
+    }
+    return ent.tpe == ET_PLATFORM;
+}
+
+// rows are split into bands, one per job thread; a band's job walks all of the
+// geometry but only writes its own rows, so the layer comes out the same on any
+// thread count, and on one thread it is a single pass
+struct CollGridBuildJob {
+    CollGrid *grid;
+    CollGridLayer *layer;
+    Array<const Entity> geometry;
+    bool walls;
+    s32 band_rows;
+};
+
+// counts into row_start[r + 1] on the count pass; on the fill pass row_start[r] has
+// the prefix sum and is bumped up to where row r + 1 begins
+void CollGridBuildBands(void *data, s32 lo, s32 hi, bool fill) {
+    CollGridBuildJob *job = (CollGridBuildJob*) data;
+    CollGridLayer *layer = job->layer;
+    s32 band_r0 = lo * job->band_rows;
+    s32 band_r1 = hi * job->band_rows - 1;
+    band_r1 = band_r1 >= job->grid->rows ? job->grid->rows - 1 : band_r1;
+
+    for (s32 i = 0; i < job->geometry.len; ++i) {
+        const Entity &ent = job->geometry.arr[i];
+        if (CollGridInLayer(ent, job->walls) == false) {
+            continue;
+        }
+        Rectangle r = ent.coll_rect;
+        s32 r0 = CollGridRow(job->grid, r.y);
+        s32 r1 = CollGridRow(job->grid, r.y + r.height);
+        r0 = r0 < band_r0 ? band_r0 : r0;
+        r1 = r1 > band_r1 ? band_r1 : r1;
+        if (fill) {
+            for (s32 row = r0; row <= r1; ++row) {
+                layer->idx[layer->row_start[row]++] = i;
+            }
+            continue;
+        }
+        u64 mask = CollGridSpanMask(CollGridCol(r.x), CollGridCol(r.x + r.width));
+        for (s32 row = r0; row <= r1; ++row) {
+            layer->bits[row] |= mask;
+            layer->row_start[row + 1]++;
+        }
+    }
+}
+
+void CollGridCountBands(void *data, s32 lo, s32 hi) {
+    CollGridBuildBands(data, lo, hi, false);
+}
+
+void CollGridFillBands(void *data, s32 lo, s32 hi) {
+    CollGridBuildBands(data, lo, hi, true);
+}
+
+CollGridLayer BuildCollGridLayer(MArena *a, CollGrid *grid, Array<const Entity> geometry, bool walls, JobSystem *jobs) {
+    CollGridLayer layer = {};
+    layer.bits = (u64*) ArenaAlloc(a, sizeof(u64) * grid->rows);
+    layer.row_start = (u32*) ArenaAlloc(a, sizeof(u32) * (grid->rows + 1));
+
+    s32 band_cnt = jobs != NULL ? jobs->thread_cnt : 1;
+    band_cnt = band_cnt > grid->rows ? grid->rows : band_cnt;
+    CollGridBuildJob job = { grid, &layer, geometry, walls, (grid->rows + band_cnt - 1) / band_cnt };
+
+    // count, prefix sum, then fill, which leaves row_start shifted up by a row
+    ParallelFor(jobs, band_cnt, 1, CollGridCountBands, &job);
+    for (s32 row = 0; row < grid->rows; ++row) {
+        layer.row_start[row + 1] += layer.row_start[row];
+    }
+    layer.idx = (u32*) ArenaAlloc(a, sizeof(u32) * layer.row_start[grid->rows]);
+
+    ParallelFor(jobs, band_cnt, 1, CollGridFillBands, &job);
+    for (s32 row = grid->rows; row > 0; --row) {
+        layer.row_start[row] = layer.row_start[row - 1];
+    }
+    layer.row_start[0] = 0;
+
+    return layer;
+}
+
+// jobs may be NULL to build on the caller
+CollGrid BuildCollGrid(MArena *a, Array<const Entity> geometry, JobSystem *jobs) {
+    CollGrid grid = {};
+    if (geometry.len == 0) {
+        return grid;
+    }
+
+    f32 y_min = geometry.arr[0].coll_rect.y;
+    f32 y_max = y_min;
+    for (s32 i = 0; i < geometry.len; ++i) {
+        Rectangle r = geometry.arr[i].coll_rect;
+        y_min = r.y < y_min ? r.y : y_min;
+        y_max = r.y + r.height > y_max ? r.y + r.height : y_max;
+    }
+    grid.y0 = floorf(y_min / COLLGRID_CELL) * COLLGRID_CELL;
+    grid.rows = (s32) ((y_max - grid.y0) / COLLGRID_CELL) + 1;
+
+    grid.platforms = BuildCollGridLayer(a, &grid, geometry, false, jobs);
+    grid.walls = BuildCollGridLayer(a, &grid, geometry, true, jobs);
+
+    return grid;
+}
+
+
+// queries
+
+// runs CatCollide once on every entity of the layer in rows y0..y1 whose bits meet
+// the x span, top row first
+void CollGridCollide(CollGrid *grid, CollGridLayer *layer, Rectangle area, Entity *cat, f32 dt, Array<const Entity> geometry, u32 *coll) {
+    s32 r0 = CollGridRow(grid, area.y);
+    s32 r1 = CollGridRow(grid, area.y + area.height);
+    r0 = r0 < 0 ? 0 : r0;
+    r1 = r1 >= grid->rows ? grid->rows - 1 : r1;
+    u64 mask = CollGridSpanMask(CollGridCol(area.x), CollGridCol(area.x + area.width));
+
+    for (s32 row = r0; row <= r1; ++row) {
+        if ((layer->bits[row] & mask) == 0) {
+            continue;
+        }
+        for (u32 j = layer->row_start[row]; j < layer->row_start[row + 1]; ++j) {
+            const Entity &ent = geometry.arr[layer->idx[j]];
+
+            // an entity over several rows is only tested in the first one searched
+            s32 first = CollGridRow(grid, ent.coll_rect.y);
+            if ((first > r0 ? first : r0) != row) {
+                continue;
+            }
+            CatCollide(cat, dt, ent, coll);
+        }
+    }
+}
+
+// CatUpdate's pass over the level geometry, walls before platforms like the column
+// walls come first in every level table
+void CollGridCatCollide(CollGrid *grid, Entity *cat, f32 dt, Array<const Entity> geometry, u32 *coll) {
+    Rectangle cr = cat->coll_rect;
+
+    // walls: the cat's box stretched by this step's horizontal move
+    f32 dx = dt * cat->velocity.x;
+    Rectangle swept = cr;
+    if (dx < 0) {
+        swept.x += dx;
+    }
+    swept.width += fabsf(dx);
+    CollGridCollide(grid, &grid->walls, swept, cat, dt, geometry, coll);
+
+    // platforms: everything the feet can pass over this step; the cat never
+    // accelerates sideways, so the x extremes are at the ends of the step
+    Arc feet = CatFeetArc(cat, CAT_GRAVITY);
+    Vector2 p1 = ArcPosition(feet, dt);
+    f32 y_lo = feet.p.y < p1.y ? feet.p.y : p1.y;
+    f32 y_hi = feet.p.y < p1.y ? p1.y : feet.p.y;
+
+    // a step that peaks midway can come back down onto a platform above both ends
+    f32 t_apex = - feet.v.y / feet.a.y;
+    if (t_apex > 0 && t_apex < dt) {
+        f32 apex = ArcPosition(feet, t_apex).y;
+        y_lo = apex < y_lo ? apex : y_lo;
+    }
+    f32 x_lo = feet.p.x < p1.x ? feet.p.x : p1.x;
+    f32 x_hi = feet.p.x < p1.x ? p1.x : feet.p.x;
+
+    Rectangle feet_area = { x_lo, y_lo, x_hi - x_lo + cr.width, y_hi - y_lo };
+    CollGridCollide(grid, &grid->platforms, feet_area, cat, dt, geometry, coll);
+}
+
+
+#endif
@@ -0,0 +1,244 @@
+#ifndef __DBGDRAW_H__
+#define __DBGDRAW_H__
+
+
+#include <atomic>
+#include <cmath>
+
+#include "raylib.h"
+#include "rlgl.h"
+#include "memory.h"
+
+
+// Debug draw.
+//
+// Lines, rectangle outlines and text queued from anywhere, job threads included, and
+// drawn together once a frame: every line and rectangle goes out as untextured quads
+// in one batch, skipping what is off screen. A shape can stay up for a number of
+// frames; flushing keeps it until its frames run out.
+//
+// Shapes go to dbg_queue, which is NULL while the debug view is off, so the DBG_*
+// macros cost a test of one pointer when nobody is looking.
+
+
+#define DBGDRAW_SHAPE_CAP (1 << 15)
+#define DBGDRAW_TEXT_CAP 1024
+#define DBGDRAW_TEXT_LEN 48
+
+enum DbgShapeType {
+    DS_LINE,
+    DS_RECT,
+};
+
+struct DbgShape {
+    u8 tpe;
+    s16 frames; // left to show, this one included
+    f32 thick;
+    Vector2 a; // line: one end, rect: top left
+    Vector2 b; // line: other end, rect: size
+    Color color;
+};
+
+struct DbgText {
+    Vector2 pos;
+    s16 size;
+    s16 frames;
+    Color color;
+    char text[DBGDRAW_TEXT_LEN];
+};
+
+struct DbgDraw {
+    DbgShape *shapes;
+    s32 shape_cap;
+    std::atomic<s32> shape_len;
+
+    DbgText *texts;
+    s32 text_cap;
+    std::atomic<s32> text_len;
+
+    std::atomic<s32> dropped; // for want of room, since the last flush
+
+    // shapes shown for a single frame are dropped on the way in when outside it
+    Rectangle view;
+};
+
+DbgDraw *dbg_queue = NULL;
+
+void InitDbgDraw(DbgDraw *dd, MArena *a, s32 shape_cap, s32 text_cap) {
+    dd->shapes = (DbgShape*) ArenaAlloc(a, sizeof(DbgShape) * shape_cap);
+    dd->shape_cap = shape_cap;
+    dd->shape_len.store(0);
+    dd->texts = (DbgText*) ArenaAlloc(a, sizeof(DbgText) * text_cap);
+    dd->text_cap = text_cap;
+    dd->text_len.store(0);
+    dd->dropped.store(0);
+    dd->view = {};
+}
+
+void DbgDrawClear(DbgDraw *dd) {
+    dd->shape_len.store(0);
+    dd->text_len.store(0);
+    dd->dropped.store(0);
+}
+
+// view is in the coordinates shapes are queued in
+void DbgDrawSetView(DbgDraw *dd, Rectangle view) {
+    dd->view = view;
+}
+
+bool DbgDrawVisible(Rectangle view, Rectangle r) {
+    return r.x <= view.x + view.width && r.x + r.width >= view.x && r.y <= view.y + view.height && r.y + r.height >= view.y;
+}
+
+
+// queueing
+
+void DbgDrawPush(DbgDraw *dd, DbgShape shape, Rectangle bounds) {
+    if (shape.frames <= 1 && dd->view.width > 0 && DbgDrawVisible(dd->view, bounds) == false) {
+        return;
+    }
+    s32 i = dd->shape_len.fetch_add(1, std::memory_order_relaxed);
+    if (i >= dd->shape_cap) {
+        dd->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    dd->shapes[i] = shape;
+}
+
+void DbgLine(DbgDraw *dd, Vector2 a, Vector2 b, f32 thick, Color color, s32 frames = 1) {
+    DbgShape shape = { DS_LINE, (s16) frames, thick, a, b, color };
+    Rectangle bounds = { a.x < b.x ? a.x : b.x, a.y < b.y ? a.y : b.y, fabsf(b.x - a.x), fabsf(b.y - a.y) };
+    DbgDrawPush(dd, shape, bounds);
+}
+
+void DbgRect(DbgDraw *dd, Rectangle rect, f32 thick, Color color, s32 frames = 1) {
+    DbgShape shape = { DS_RECT, (s16) frames, thick, { rect.x, rect.y }, { rect.width, rect.height }, color };
+    DbgDrawPush(dd, shape, rect);
+}
+
+void DbgTextAt(DbgDraw *dd, Vector2 pos, s32 size, Color color, const char *text, s32 frames = 1) {
+    s32 i = dd->text_len.fetch_add(1, std::memory_order_relaxed);
+    if (i >= dd->text_cap) {
+        dd->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    DbgText *t = dd->texts + i;
+    t->pos = pos;
+    t->size = (s16) size;
+    t->frames = (s16) frames;
+    t->color = color;
+    strncpy(t->text, text, DBGDRAW_TEXT_LEN - 1);
+    t->text[DBGDRAW_TEXT_LEN - 1] = 0;
+}
+
+#define DBG_LINE(...) (dbg_queue ? DbgLine(dbg_queue, __VA_ARGS__) : (void) 0)
+#define DBG_RECT(...) (dbg_queue ? DbgRect(dbg_queue, __VA_ARGS__) : (void) 0)
+#define DBG_TEXT(...) (dbg_queue ? DbgTextAt(dbg_queue, __VA_ARGS__) : (void) 0)
+
+
+// drawing
+
+void DbgQuad(f32 x0, f32 y0, f32 x1, f32 y1) {
+    rlCheckRenderBatchLimit(4);
+    rlVertex2f(x0, y0);
+    rlVertex2f(x0, y1);
+    rlVertex2f(x1, y1);
+    rlVertex2f(x1, y0);
+}
+
+// everything queued, in one batch of quads plus the text; origin is subtracted like
+// in DrawTexturePro. Must not race with queueing, so call it once the frame's jobs
+// are done. Returns how many shapes were on screen.
+s32 DbgDrawFlush(DbgDraw *dd, Vector2 origin, Rectangle view) {
+    s32 shape_len = dd->shape_len.load();
+    s32 text_len = dd->text_len.load();
+    shape_len = shape_len > dd->shape_cap ? dd->shape_cap : shape_len;
+    text_len = text_len > dd->text_cap ? dd->text_cap : text_len;
+
+    s32 drawn = 0;
+    rlSetTexture(0);
+    rlBegin(RL_QUADS);
+    rlNormal3f(0.0f, 0.0f, 1.0f);
+
+    for (s32 i = 0; i < shape_len; ++i) {
+        DbgShape *s = dd->shapes + i;
+        rlColor4ub(s->color.r, s->color.g, s->color.b, s->color.a);
+
+        if (s->tpe == DS_RECT) {
+            Rectangle r = { s->a.x, s->a.y, s->b.x, s->b.y };
+            if (DbgDrawVisible(view, r) == false) {
+                continue;
+            }
+
+            // outlined on the inside, like DrawRectangleLinesEx
+            f32 t = s->thick;
+            f32 x0 = r.x - origin.x;
+            f32 y0 = r.y - origin.y;
+            f32 x1 = x0 + r.width;
+            f32 y1 = y0 + r.height;
+            DbgQuad(x0, y0, x1, y0 + t);
+            DbgQuad(x0, y1 - t, x1, y1);
+            DbgQuad(x0, y0 + t, x0 + t, y1 - t);
+            DbgQuad(x1 - t, y0 + t, x1, y1 - t);
+        }
+        else {
+            Rectangle bounds = { s->a.x < s->b.x ? s->a.x : s->b.x, s->a.y < s->b.y ? s->a.y : s->b.y, fabsf(s->b.x - s->a.x), fabsf(s->b.y - s->a.y) };
+            if (DbgDrawVisible(view, bounds) == false) {
+                continue;
+            }
+
+            Vector2 d = { s->b.x - s->a.x, s->b.y - s->a.y };
+            f32 len = sqrtf(d.x * d.x + d.y * d.y);
+            if (len == 0) {
+                continue;
+            }
+            Vector2 n = { - d.y / len * s->thick / 2, d.x / len * s->thick / 2 };
+            f32 ax = s->a.x - origin.x;
+            f32 ay = s->a.y - origin.y;
+            f32 bx = s->b.x - origin.x;
+            f32 by = s->b.y - origin.y;
+
+            rlCheckRenderBatchLimit(4);
+            rlVertex2f(ax + n.x, ay + n.y);
+            rlVertex2f(ax - n.x, ay - n.y);
+            rlVertex2f(bx - n.x, by - n.y);
+            rlVertex2f(bx + n.x, by + n.y);
+        }
+        drawn++;
+    }
+    rlEnd();
+
+    for (s32 i = 0; i < text_len; ++i) {
+        DbgText *t = dd->texts + i;
+        if (DbgDrawVisible(view, { t->pos.x, t->pos.y, 0, 0 })) {
+            DrawText(t->text, (s32) (t->pos.x - origin.x), (s32) (t->pos.y - origin.y), t->size, t->color);
+        }
+    }
+
+    // keep what stays up for more frames, in order
+    s32 kept = 0;
+    for (s32 i = 0; i < shape_len; ++i) {
+        if (dd->shapes[i].frames > 1) {
+            dd->shapes[kept] = dd->shapes[i];
+            dd->shapes[kept].frames--;
+            kept++;
+        }
+    }
+    dd->shape_len.store(kept);
+
+    kept = 0;
+    for (s32 i = 0; i < text_len; ++i) {
+        if (dd->texts[i].frames > 1) {
+            dd->texts[kept] = dd->texts[i];
+            dd->texts[kept].frames--;
+            kept++;
+        }
+    }
+    dd->text_len.store(kept);
+    dd->dropped.store(0);
+
+    return drawn;
+}
+
+
+#endif
@@ -0,0 +1,139 @@
+#ifndef __DYNRES_H__
+#define __DYNRES_H__
+
+
+#include <cmath>
+
+#include "raylib.h"
+#include "memory.h"
+
+
+// Dynamic resolution.
+//
+// When on, the game is drawn into an offscreen target at a fraction of the window
+// resolution and stretched over the window with bilinear filtering. The fraction
+// follows how long frames take to produce: over the budget it drops right away, by
+// as much as the overshoot asks for, and with plenty of room it climbs back slowly.
+// After every change it waits for the average to settle before judging again.
+//
+// raylib has no GPU timer queries, so the time measured is the CPU side of the frame
+// up to and including the buffer swap, which stalls once the GPU falls behind.
+//
+// The target is allocated at the full window size and only the top left scale * size
+// of it is drawn into, so changing the scale never reallocates.
+
+
+#define DYNRES_SCALE_MIN 0.5f
+#define DYNRES_SCALE_MAX 1.0f
+#define DYNRES_SCALE_STEP 0.05f
+#define DYNRES_BUDGET 0.8f // of the frame period
+#define DYNRES_HEADROOM 0.6f // of the budget; below it the scale goes back up
+#define DYNRES_SMOOTH 0.1f
+#define DYNRES_SETTLE_FRAMES 30
+
+struct DynamicResolution {
+    bool on;
+    RenderTexture2D target;
+    f32 scale;
+    f32 work_ms; // smoothed
+    s32 settle;
+};
+
+DynamicResolution InitDynamicResolution() {
+    DynamicResolution dr = {};
+    dr.scale = DYNRES_SCALE_MAX;
+    return dr;
+}
+
+void DynResRelease(DynamicResolution *dr) {
+    if (dr->target.id != 0) {
+        UnloadRenderTexture(dr->target);
+        dr->target = {};
+    }
+}
+
+// (re)allocates the target at the window size; called on resize while on
+void DynResResize(DynamicResolution *dr) {
+    if (dr->on == false) {
+        return;
+    }
+    DynResRelease(dr);
+    dr->target = LoadRenderTexture(GetScreenWidth(), GetScreenHeight());
+    SetTextureFilter(dr->target.texture, TEXTURE_FILTER_BILINEAR);
+}
+
+void DynResToggle(DynamicResolution *dr) {
+    dr->on = !dr->on;
+    dr->scale = DYNRES_SCALE_MAX;
+    dr->settle = DYNRES_SETTLE_FRAMES;
+    if (dr->on) {
+        DynResResize(dr);
+    }
+    else {
+        DynResRelease(dr);
+    }
+}
+
+// work_ms is how long the last frame took to produce, not counting the pacer's wait
+void DynResUpdate(DynamicResolution *dr, f32 work_ms, f32 period_ms) {
+    dr->work_ms += (work_ms - dr->work_ms) * DYNRES_SMOOTH;
+    if (dr->on == false) {
+        return;
+    }
+    if (dr->settle > 0) {
+        dr->settle--;
+        return;
+    }
+
+    f32 budget = period_ms * DYNRES_BUDGET;
+    f32 scale = dr->scale;
+    if (dr->work_ms > budget) {
+        // the pixels to fill go with the square of the scale; down in whole steps
+        scale *= sqrtf(budget / dr->work_ms);
+        scale = floorf(scale / DYNRES_SCALE_STEP) * DYNRES_SCALE_STEP;
+    }
+    else if (dr->work_ms < budget * DYNRES_HEADROOM) {
+        scale += DYNRES_SCALE_STEP;
+    }
+    scale = scale < DYNRES_SCALE_MIN ? DYNRES_SCALE_MIN : (scale > DYNRES_SCALE_MAX ? DYNRES_SCALE_MAX : scale);
+
+    if (fabsf(scale - dr->scale) > DYNRES_SCALE_STEP / 2) {
+        dr->scale = scale;
+        dr->settle = DYNRES_SETTLE_FRAMES;
+    }
+}
+
+// the camera for drawing into the target: everything on screen shrinks by the scale.
+// Draw calls keep using the window camera's offset as their origin.
+Camera2D DynResCamera(DynamicResolution *dr, Camera2D cam) {
+    if (dr->on) {
+        cam.offset = { cam.offset.x * dr->scale, cam.offset.y * dr->scale };
+        cam.zoom *= dr->scale;
+    }
+    return cam;
+}
+
+void DynResBeginScene(DynamicResolution *dr) {
+    if (dr->on) {
+        BeginTextureMode(dr->target);
+    }
+}
+
+// stretches what was drawn over the window
+void DynResEndScene(DynamicResolution *dr) {
+    if (dr->on == false) {
+        return;
+    }
+    EndTextureMode();
+
+    // render textures are stored bottom up; the scene is in the top left, which is
+    // the bottom rows of the texture
+    f32 w = dr->target.texture.width * dr->scale;
+    f32 h = dr->target.texture.height * dr->scale;
+    Rectangle src = { 0, dr->target.texture.height - h, w, - h };
+    Rectangle dst = { 0, 0, (f32) GetScreenWidth(), (f32) GetScreenHeight() };
+    DrawTexturePro(dr->target.texture, src, dst, { 0, 0 }, 0.0f, WHITE);
+}
+
+
+#endif
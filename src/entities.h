@@ -5,6 +5,12 @@
 #include "raylib.h"
 #include "memory.h"
 #include "helpers.h"
+#include "input.h"
+#include "trajectory.h"
+#include "jobs.h"
+#include "stats.h"
+#include "dbgdraw.h"
+#include "triggers.h"
 
 
 #define MAX_ANIMATIONS 4
@@ -25,6 +31,17 @@ enum EntityType {
     ET_CNT
 };
 
+enum EntityFlags {
+    EF_KINEMATIC = 1 << 0, // placed by its mover path (movers.h), never integrated
+    EF_ASLEEP = 1 << 1, // out of the awake regions (activity.h), not updated and may be stale
+};
+
+// the state of platforms and trapdoors that open and close
+enum GateState {
+    GATE_CLOSED,
+    GATE_OPEN,
+};
+
 struct Frame {
     Rectangle source;
     s32 duration;
@@ -52,11 +69,11 @@ struct Animation {
     Frame frames[MAX_ANIMATION_FRAMES];
 };
 
-Animation InitAnimation(const char* anifile, EntityType tpe) {
+Animation InitAnimationFromTexture(Texture texture, EntityType tpe) {
     Animation ani = {};
 
     ani.tpe = tpe;
-    ani.texture = LoadTexture(anifile);
+    ani.texture = texture;
     assert(ani.texture.width % ani.texture.height == 0);
     ani.frame_cnt = ani.texture.width / ani.texture.height;
     ani.frame_sz = ani.texture.height;
@@ -69,6 +86,10 @@ Animation InitAnimation(const char* anifile, EntityType tpe) {
     return ani;
 }
 
+Animation InitAnimation(const char* anifile, EntityType tpe) {
+    return InitAnimationFromTexture(LoadTexture(anifile), tpe);
+}
+
 struct EntityInterface {
     virtual void Update(f32 dt) = 0;
     virtual Frame GetFrame(Texture *texture) = 0;
@@ -78,10 +99,14 @@ struct Entity {
     EntityType tpe;
     s32 facing_right;
     s32 state;
+    u32 flags;
+    s32 mover_idx;
 
     // kinematics
     Vector2 anchor;
     Vector2 velocity;
+    Vector2 accel;
+    Vector2 ground_velocity; // of what the entity stands on
     Rectangle coll_rect;
     Vector2 coll_offset;
 
@@ -94,9 +119,12 @@ struct Entity {
     s32 frame_idx;
     f32 frame_elapsed;
 
+    // exact for constant acceleration, see trajectory.h
     void Update(f32 dt) {
-        anchor.x += dt * velocity.x;
-        anchor.y += dt * velocity.y;
+        anchor.x += dt * velocity.x + 0.5f * accel.x * dt * dt;
+        anchor.y += dt * velocity.y + 0.5f * accel.y * dt * dt;
+        velocity.x += dt * accel.x;
+        velocity.y += dt * accel.y;
 
         ani_rect.x = anchor.x + ani_offset.x;
         ani_rect.y = anchor.y + ani_offset.y;
@@ -127,10 +155,11 @@ struct Entity {
         }
     }
 
-    void DrawWireframes_DBG(Vector2 offset) {
-        DrawRectangleLinesEx( Offset(ani_rect, offset), 2, WHITE);
-        DrawRectangleLinesEx( Offset(coll_rect, offset), 4, BLUE);
-        DrawRectangleLinesEx( Rectangle{ Offset(anchor, offset).x, Offset(anchor, offset).y, 2, 2 }, 2, RED);
+    // queued, see dbgdraw.h
+    void DrawWireframes_DBG() const {
+        DBG_RECT(ani_rect, 2, WHITE);
+        DBG_RECT(coll_rect, 4, BLUE);
+        DBG_RECT(Rectangle{ anchor.x, anchor.y, 2, 2 }, 2, RED);
     }
 };
 
@@ -149,23 +178,38 @@ enum CatState {
 #define CAT_RUN_SPEED 0.15f * SPRITE_SCALE
 #define CAT_JUMP_SPEED 0.29f * SPRITE_SCALE
 #define CAT_JUMP_BRAKE_MULT 0.3f * SPRITE_SCALE
-#define CAT_FALL_ACCEL 0.014f * SPRITE_SCALE
+#define CAT_FALL_ACCEL 0.014f * SPRITE_SCALE // per 60 Hz tick
+#define CAT_TICK_MS (1000.0f / 60.0f)
+#define CAT_GRAVITY (CAT_FALL_ACCEL / CAT_TICK_MS) // per ms
+#define CAT_FALL_OUT_Y 2048 // top of the kill zone, on a trigger cell edge
+#define CAT_RIDE_SLACK (CAT_GRAVITY * CAT_TICK_MS) // relative velocity, per ms
+
+Arc CatFeetArc(const Entity *cat, f32 accel_y) {
+    Rectangle cr = cat->coll_rect;
+    Arc feet = {};
+    feet.p = { cr.x, cr.y + cr.height };
+    feet.v = cat->velocity;
+    feet.a = { cat->accel.x, accel_y };
+    return feet;
+}
 
-bool CollidePlatform(Entity cat, f32 delta_y, Rectangle rect) {
-    Rectangle cr = cat.coll_rect;
-    if (delta_y > 0) {
-        Rectangle next = { cr.x, cr.y + cr.height, cr.width, delta_y };
-        return CheckCollisionRecs(next, rect);
-    }
-    else if (delta_y < 0) {
-        return false;
-    }
-    else {
-        return CheckCollisionRecs(cr, rect);
+// whether the cat, falling for the next dt, lands on the platform; the whole arc is
+// tested, so no step length can tunnel through a 2-unit platform. Moving platforms
+// are tested in their own frame, against the cat's velocity relative to them.
+bool CollidePlatform(Entity cat, f32 dt, Rectangle rect, Vector2 rect_velocity) {
+    Arc feet = CatFeetArc(&cat, CAT_GRAVITY);
+    feet.v.x -= rect_velocity.x;
+    feet.v.y -= rect_velocity.y;
+
+    // a riding cat took the platform's velocity a step ago; a platform easing off
+    // upwards leaves it rising slightly relative to it, but not off it
+    if (rect_velocity.y != 0 && feet.v.y < 0 && feet.v.y > - CAT_RIDE_SLACK) {
+        feet.v.y = 0;
     }
+    return ArcTimeOfImpactPlatform(feet, cat.coll_rect.width, rect, dt) != TOI_NONE;
 }
 
-bool CollideWall(Entity cat, f32 delta_x, Entity wall) {
+bool CollideWall(Entity cat, f32 delta_x, const Entity &wall) {
     Rectangle rect = wall.coll_rect;
     Rectangle cr = cat.coll_rect;
     Rectangle next = {};
@@ -175,82 +219,145 @@ bool CollideWall(Entity cat, f32 delta_x, Entity wall) {
     }
     else if ((wall.tpe == ET_WALL_LEFT) && (delta_x < 0)) {
         next = { cr.x + delta_x, cr.y, - delta_x, cr.height };
-        return CheckCollisionRecs(next, rect);
+        bool coll = CheckCollisionRecs(next, rect);
+        DBG_RECT(next, 1, coll ? RED : ORANGE);
+        return coll;
     }
     else if ((wall.tpe == ET_WALL_RIGHT) && (delta_x > 0)) {
         next = { cr.x + cr.width, cr.y, delta_x, cr.height };
         bool coll = CheckCollisionRecs(next, rect);
+        DBG_RECT(next, 1, coll ? RED : ORANGE);
         return coll;
     }
     return false;
 }
 
-bool CollidePortal(Entity cat, Vector2 delta, Rectangle rect) {
-    Rectangle cr = cat.coll_rect;
-    Vector2 next = { cr.x + delta.x, cr.y + delta.y };
-    return CheckCollisionPointRec(next, rect) || CheckCollisionRecs(cr, rect);
-}
-
-void CatUpdate(Entity *cat, f32 dt, Array<Entity> entities, bool *out_fall, bool *out_exit) {
-    bool key_left = DoMoveLeft();
-    bool key_right = DoMoveRight();
-    bool key_space = DoJump();
+// what the cat hit during one CatUpdate
+enum CatCollision {
+    CC_PLATFORM = 1 << 0, // stands on a platform or closed trapdoor
+    CC_SNAP = 1 << 1, // and landed on it this tick, moving anchor.y
+    CC_WALL = 1 << 2,
+    CC_PORTAL = 1 << 3, // is in the portal's trigger volume
+};
 
-    if (cat->anchor.y > 2056) {
-        *out_fall = true;
-        return;
+// collides the cat with one platform or wall, adding to the CatCollision flags in coll
+void CatCollide(Entity *cat, f32 dt, const Entity &ent, u32 *coll) {
+    bool is_floor = ent.tpe == ET_PLATFORM || ent.tpe == ET_TRAPDOOR;
+    if (is_floor && ent.state == GATE_CLOSED && (*coll & CC_PLATFORM) == 0) {
+        bool did_collide = CollidePlatform(*cat, dt, ent.coll_rect, ent.velocity);
+        STAT_INC(STAT_COLL_TESTS_PLATFORM);
+        DBG_RECT(ent.coll_rect, 2, did_collide ? GREEN : YELLOW);
+
+        // on a moving platform the cat keeps its pace
+        if (did_collide) {
+            STAT_INC(STAT_COLL_HITS_PLATFORM);
+            *coll |= CC_PLATFORM;
+            // only on landing; riding a platform that moves up and down drifts off
+            // its closed form a little every tick, which is not a snap
+            bool landing = cat->accel.y != 0; // falling the tick before
+            if (landing && cat->anchor.y != ent.coll_rect.y + 1) {
+                *coll |= CC_SNAP;
+                DBG_RECT(Rectangle{ cat->anchor.x - 4, ent.coll_rect.y - 4, 8, 8 }, 2, SKYBLUE, 120);
+            }
+            cat->velocity.y = ent.velocity.y;
+            cat->ground_velocity = ent.velocity;
+            cat->anchor.y = ent.coll_rect.y + 1;
+        }
     }
+    else if (ent.tpe == ET_WALL_LEFT) {
+        bool did_collide_wall_left = CollideWall(*cat, dt * cat->velocity.x, ent);
+        STAT_INC(STAT_COLL_TESTS_WALL);
+        if (did_collide_wall_left ) {
+            STAT_INC(STAT_COLL_HITS_WALL);
+            *coll |= CC_WALL;
+            cat->velocity.x = 0;
+            cat->anchor.x = ent.anchor.x + cat->coll_rect.width / 2 - 2;
+        }
+    }
+    else if (ent.tpe == ET_WALL_RIGHT) {
+        bool did_collide_wall_left = CollideWall(*cat, dt * cat->velocity.x, ent);
+        STAT_INC(STAT_COLL_TESTS_WALL);
+        if (did_collide_wall_left ) {
+            STAT_INC(STAT_COLL_HITS_WALL);
+            *coll |= CC_WALL;
+            cat->velocity.x = 0;
+            cat->anchor.x = ent.anchor.x - cat->coll_rect.width / 2 - 5;
+        }
+    }
+}
+
+// collgrid.h; levels that have a grid pass it to CatUpdate to skip the linear scan
+struct CollGrid;
+void CollGridCatCollide(CollGrid *grid, Entity *cat, f32 dt, Array<const Entity> geometry, u32 *coll);
 
-    if (key_right && !key_left) {
+// faces and runs the cat the way input.left and input.right say
+void CatSteer(Entity *cat, CatInput input) {
+    if (input.right && !input.left) {
         cat->facing_right = true;
         cat->velocity.x = CAT_RUN_SPEED;
     }
-    else if (key_left && !key_right) {
+    else if (input.left && !input.right) {
         cat->facing_right = false;
         cat->velocity.x = - CAT_RUN_SPEED;
     }
     else {
         cat->velocity.x = 0;
     }
+}
 
-    bool did_collide = false;
-    for (s32 i = 0; i < entities.len; ++i) {
-        Entity ent = entities.arr[i];
+// returns the CatCollision flags of the tick. What the cat's trigger volumes do is up
+// to the caller, through the events queued on events; in the kill zone or the portal
+// the update stops short, with no flags or just CC_PORTAL.
+u32 CatUpdate(Entity *cat, f32 dt, CatInput input, Array<const Entity> geometry, Array<Entity> entities, const TriggerSet *triggers, TriggerContact *contact, TriggerQueue *events, CollGrid *grid = NULL) {
+    bool key_space = input.jump;
+
+    CatSteer(cat, input);
+    cat->ground_velocity = {};
+
+    // the volumes the cat's box meets over this step
+    Rectangle swept = cat->coll_rect;
+    Vector2 delta = { dt * cat->velocity.x, dt * cat->velocity.y };
+    swept.x += delta.x < 0 ? delta.x : 0;
+    swept.y += delta.y < 0 ? delta.y : 0;
+    swept.width += fabsf(delta.x);
+    swept.height += fabsf(delta.y);
+    TriggerUpdate(triggers, contact, swept, events);
+    if (TriggerContactIn(triggers, contact, TK_KILL)) {
+        return 0;
+    }
+    if (TriggerContactIn(triggers, contact, TK_PORTAL)) {
+        return CC_PORTAL;
+    }
 
-        if (ent.tpe == ET_PLATFORM && !did_collide) {
-            did_collide = CollidePlatform(*cat, dt * cat->velocity.y, ent.coll_rect);
+    if (dbg_queue) {
+        // where the feet can go this step
+        Arc feet = CatFeetArc(cat, CAT_GRAVITY);
+        Vector2 p1 = ArcPosition(feet, dt);
+        Rectangle sweep = { feet.p.x < p1.x ? feet.p.x : p1.x, feet.p.y < p1.y ? feet.p.y : p1.y, fabsf(p1.x - feet.p.x) + cat->coll_rect.width, fabsf(p1.y - feet.p.y) };
+        DBG_RECT(sweep, 1, MAGENTA);
+    }
 
-            if (did_collide) {
-                cat->velocity.y = 0;
-                cat->anchor.y = ent.anchor.y + 1;
-            }
-        }
-        else if (ent.tpe == ET_WALL_LEFT) {
-            bool did_collide_wall_left = CollideWall(*cat, dt * cat->velocity.x, ent);
-            if (did_collide_wall_left ) {
-                cat->velocity.x = 0;
-                cat->anchor.x = ent.anchor.x + cat->coll_rect.width / 2 - 2;
-            }
-        }
-        else if (ent.tpe == ET_WALL_RIGHT) {
-            bool did_collide_wall_left = CollideWall(*cat, dt * cat->velocity.x, ent);
-            if (did_collide_wall_left ) {
-                cat->velocity.x = 0;
-                cat->anchor.x = ent.anchor.x - cat->coll_rect.width / 2 - 5;
-            }
+    u32 coll = 0;
+    if (grid != NULL) {
+        CollGridCatCollide(grid, cat, dt, geometry, &coll);
+    }
+    else {
+        for (s32 i = 0; i < geometry.len; ++i) {
+            CatCollide(cat, dt, geometry.arr[i], &coll);
         }
-        else if (ent.tpe == ET_PORTAL) {
-            bool did_collide_portal = CollidePortal(*cat, { dt * cat->velocity.x, dt * cat->velocity.y }, ent.coll_rect);
-            if (did_collide_portal) {
-                *out_exit = true;
-                return;
-            }
+    }
+    for (s32 i = 0; i < entities.len; ++i) {
+        if ((entities.arr[i].flags & EF_ASLEEP) == 0) {
+            CatCollide(cat, dt, entities.arr[i], &coll);
         }
     }
+    bool did_collide = (coll & CC_PLATFORM) != 0;
     if (did_collide == false) {
-        cat->velocity.y += CAT_FALL_ACCEL;
+        cat->accel.y = CAT_GRAVITY;
     }
     else {
+        cat->accel.y = 0;
+
         // can only jump from a platform
         if (key_space) {
             cat->velocity.y = -1.0f * CAT_JUMP_SPEED;
@@ -282,6 +389,35 @@ void CatUpdate(Entity *cat, f32 dt, Array<Entity> entities, bool *out_fall, bool
     else {
         cat->frame_elapsed += dt;
     }
+
+    // carried along after the state is picked, so riding still looks like standing
+    cat->velocity.x += cat->ground_velocity.x;
+
+    return coll;
+}
+
+struct EntityUpdateJob {
+    Entity *entities;
+    f32 dt;
+};
+
+void EntityUpdateRange(void *data, s32 lo, s32 hi) {
+    EntityUpdateJob *job = (EntityUpdateJob*) data;
+    for (s32 i = lo; i < hi; ++i) {
+        Entity *ent = job->entities + i;
+        if (ent->tpe == ET_UNKNOWN || (ent->flags & EF_KINEMATIC)) {
+            continue;
+        }
+        ent->Update(job->dt);
+    }
+}
+
+#define ENTITY_UPDATE_GRAIN 256
+
+// entities move independently of each other, small sets stay on the calling thread
+void UpdateEntities(JobSystem *jobs, Array<Entity> entities, f32 dt) {
+    EntityUpdateJob job = { entities.arr, dt };
+    ParallelFor(jobs, entities.len, ENTITY_UPDATE_GRAIN, EntityUpdateRange, &job);
 }
 
 void UnloadTextures(Array<Animation> animations) {
@@ -290,11 +426,11 @@ void UnloadTextures(Array<Animation> animations) {
     }
 }
 
-Entity InitPlatform(Vector2 position, f32 width) {
+constexpr Entity InitPlatform(Vector2 position, f32 width) {
     Entity platform = {};
     platform.tpe = ET_PLATFORM;
     platform.anchor = position;
-    platform.coll_rect = {0, 0, width, 2};
+    platform.coll_rect = { position.x, position.y, width, 2 };
 
     f32 height = 50;
     platform.ani_rect = platform.coll_rect;
@@ -303,7 +439,7 @@ Entity InitPlatform(Vector2 position, f32 width) {
     return platform;
 }
 
-Entity InitWall(Vector2 position, f32 height, bool is_left) {
+constexpr Entity InitWall(Vector2 position, f32 height, bool is_left) {
     Entity platform = {};
     platform.tpe = ET_WALL_RIGHT;
     if (is_left) {
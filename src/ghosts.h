@@ -0,0 +1,382 @@
+#ifndef __GHOSTS_H__
+#define __GHOSTS_H__
+
+
+#include <ctime>
+
+#include "raylib.h"
+#include "rlgl.h"
+#include "memory.h"
+#include "input.h"
+#include "entities.h"
+#include "levels.h"
+
+
+// Ghost replays.
+//
+// A run is the input stream of one attempt at a level, together with the dt of every
+// frame, so replaying it through CatUpdate reproduces the attempt exactly. Many runs
+// are simulated side by side as ghost cats and drawn in one batch from an atlas of
+// the cat sheets.
+
+
+#define GHOST_MAGIC 0x48474A43 // "CJGH"
+#define GHOST_VERSION 1
+#define GHOST_MAX_FRAMES (60 * 60 * 10)
+#define GHOST_DIR "ghosts"
+
+struct GhostFileHeader {
+    u32 magic;
+    u16 version;
+    u16 level;
+    u32 frame_cnt;
+};
+
+struct GhostRun {
+    s32 frame_cnt;
+    f32 *dts;
+    u8 *inputs;
+};
+
+const char *GhostLevelDir(s32 level) {
+    return TextFormat("%s/level%02d", GHOST_DIR, level);
+}
+
+
+// recording
+
+struct GhostRecorder {
+    s32 level;
+    GhostRun run;
+    bool overflow;
+};
+
+GhostRecorder GhostRecorderInit(MArena *a) {
+    GhostRecorder rec = {};
+    rec.run.dts = (f32*) ArenaAlloc(a, sizeof(f32) * GHOST_MAX_FRAMES);
+    rec.run.inputs = (u8*) ArenaAlloc(a, sizeof(u8) * GHOST_MAX_FRAMES);
+    return rec;
+}
+
+void GhostRecorderStart(GhostRecorder *rec, s32 level) {
+    rec->level = level;
+    rec->run.frame_cnt = 0;
+    rec->overflow = false;
+}
+
+void GhostRecorderAdd(GhostRecorder *rec, f32 dt, CatInput input) {
+    if (rec->run.frame_cnt == GHOST_MAX_FRAMES) {
+        rec->overflow = true;
+        return;
+    }
+    rec->run.dts[rec->run.frame_cnt] = dt;
+    rec->run.inputs[rec->run.frame_cnt] = PackInput(input);
+    rec->run.frame_cnt++;
+}
+
+// writes the run to ghosts/levelNN/; the frame data is laid out as all dts, then all inputs
+bool GhostRecorderSave(GhostRecorder *rec, MArena *scratch) {
+    if (rec->overflow || rec->run.frame_cnt == 0) {
+        return false;
+    }
+
+    s32 n = rec->run.frame_cnt;
+    u32 size = sizeof(GhostFileHeader) + n * (sizeof(f32) + sizeof(u8));
+    u64 used = scratch->used;
+    u8 *data = (u8*) ArenaAlloc(scratch, size);
+
+    GhostFileHeader hdr = { GHOST_MAGIC, GHOST_VERSION, (u16) rec->level, (u32) n };
+    memcpy(data, &hdr, sizeof(hdr));
+    memcpy(data + sizeof(hdr), rec->run.dts, n * sizeof(f32));
+    memcpy(data + sizeof(hdr) + n * sizeof(f32), rec->run.inputs, n * sizeof(u8));
+
+    const char *dir = GhostLevelDir(rec->level);
+    bool ok = (DirectoryExists(GHOST_DIR) || MakeDirectory(GHOST_DIR) == 0);
+    ok = ok && (DirectoryExists(dir) || MakeDirectory(dir) == 0);
+    if (ok) {
+        ok = SaveFileData(TextFormat("%s/%lld_%d.cjg", dir, (long long) time(NULL), n), data, size);
+    }
+
+    scratch->used = used;
+    return ok;
+}
+
+
+// playback
+
+struct GhostPlayback {
+    GhostRun run;
+    s32 cursor;
+    f32 time;
+    bool done;
+    TriggerContact contact;
+};
+
+struct GhostSet {
+    MArena arena;
+    Array<GhostPlayback> ghosts;
+    Array<Entity> cats; // parallel to ghosts
+};
+
+GhostSet GhostSetInit(void *mem, u64 cap) {
+    GhostSet set = {};
+    set.arena = ArenaCreate(mem, cap);
+    return set;
+}
+
+bool GhostRunParse(MArena *a, u8 *data, s32 size, s32 level, GhostRun *out) {
+    GhostFileHeader hdr = {};
+    if (size < (s32) sizeof(hdr)) {
+        return false;
+    }
+    memcpy(&hdr, data, sizeof(hdr));
+
+    s32 n = hdr.frame_cnt;
+    if (hdr.magic != GHOST_MAGIC || hdr.version != GHOST_VERSION || hdr.level != level) {
+        return false;
+    }
+    if (n <= 0 || n > GHOST_MAX_FRAMES || size != (s32) (sizeof(hdr) + n * (sizeof(f32) + sizeof(u8)))) {
+        return false;
+    }
+    if (a->used + n * (sizeof(f32) + sizeof(u8)) + 2 * ARENA_ALIGN > a->cap) {
+        return false;
+    }
+
+    out->frame_cnt = n;
+    out->dts = (f32*) ArenaPush(a, data + sizeof(hdr), n * sizeof(f32));
+    out->inputs = (u8*) ArenaPush(a, data + sizeof(hdr) + n * sizeof(f32), n * sizeof(u8));
+    return true;
+}
+
+// loads every recorded run of the level, up to max_ghosts
+void GhostSetLoad(GhostSet *set, s32 level, s32 max_ghosts) {
+    ArenaClear(&set->arena);
+    set->ghosts = InitArray<GhostPlayback>(&set->arena, max_ghosts);
+    set->cats = InitArray<Entity>(&set->arena, max_ghosts);
+
+    const char *dir = GhostLevelDir(level);
+    if (DirectoryExists(dir) == false) {
+        return;
+    }
+
+    FilePathList files = LoadDirectoryFilesEx(dir, ".cjg", false);
+    for (u32 i = 0; i < files.count && set->ghosts.len < set->ghosts.cap; ++i) {
+        s32 size = 0;
+        u8 *data = LoadFileData(files.paths[i], &size);
+        if (data == NULL) {
+            continue;
+        }
+
+        GhostPlayback ghost = {};
+        if (GhostRunParse(&set->arena, data, size, level, &ghost.run)) {
+            set->ghosts.Add(ghost);
+        }
+        UnloadFileData(data);
+    }
+    UnloadDirectoryFiles(files);
+}
+
+// puts every ghost back at the start of its run, as a copy of the level's cat
+void GhostSetRestart(GhostSet *set, Entity cat, Vector2 spawn) {
+    cat.anchor = spawn;
+    cat.velocity = {};
+    cat.accel = {};
+    cat.Update(0);
+
+    set->cats.len = 0;
+    for (s32 i = 0; i < set->ghosts.len; ++i) {
+        GhostPlayback *ghost = set->ghosts.arr + i;
+        ghost->cursor = 0;
+        ghost->time = 0;
+        ghost->done = false;
+        ghost->contact = InitTriggerContact();
+        set->cats.Add(cat);
+    }
+}
+
+#define GHOST_NEAR_MAX 16 // movers one ghost step can reach; past it the rest are left out
+#define GHOST_NEAR_MARGIN (32.0f * SPRITE_SCALE) // around a step, for a mover carrying the cat
+
+struct GhostUpdateJob {
+    GhostSet *set;
+    f32 level_time;
+    Array<const Entity> geometry;
+    CollGrid *grid;
+    TriggerSet *triggers;
+    MoverSet *movers;
+    Array<Entity> entities;
+    Array<Animation> animations;
+};
+
+// The kinematic entities a ghost's step can touch, posed where they were at the
+// ghost's own time, the start of the step, like the recording saw them. The level's
+// movers are posed for the player's frame, which a replayed step does not line up
+// with.
+Array<Entity> GhostMoversNear(GhostUpdateJob *job, const Entity *cat, f32 dt, f64 time, Entity *near) {
+    Rectangle cr = cat->coll_rect;
+    f32 mx = (fabsf(cat->velocity.x) + CAT_RUN_SPEED) * dt + GHOST_NEAR_MARGIN;
+    f32 my = (fabsf(cat->velocity.y) + CAT_JUMP_SPEED) * dt + CAT_GRAVITY * dt * dt + GHOST_NEAR_MARGIN;
+    Rectangle area = { cr.x - mx, cr.y - my, cr.width + 2 * mx, cr.height + 2 * my };
+
+    Array<Entity> out = {};
+    out.arr = near;
+    out.cap = GHOST_NEAR_MAX;
+    for (s32 i = 0; i < job->entities.len; ++i) {
+        const Entity *ent = job->entities.arr + i;
+        if ((ent->flags & EF_KINEMATIC) == 0 || CheckCollisionRecs(MoverPathRect(job->movers, ent, 0), area) == false) {
+            continue;
+        }
+        assert(out.len < out.cap && "more movers near a ghost than it tracks");
+        if (out.len < out.cap) {
+            out.Add(MoverPosedAt(job->movers, ent, time));
+        }
+    }
+    return out;
+}
+
+void GhostUpdateRange(void *data, s32 lo, s32 hi) {
+    GhostUpdateJob *job = (GhostUpdateJob*) data;
+    GhostSet *set = job->set;
+
+    for (s32 i = lo; i < hi; ++i) {
+        GhostPlayback *ghost = set->ghosts.arr + i;
+        Entity *cat = set->cats.arr + i;
+
+        while (ghost->done == false && ghost->cursor < ghost->run.frame_cnt) {
+            f32 dt = ghost->run.dts[ghost->cursor];
+            if (ghost->time + dt > job->level_time) {
+                break;
+            }
+            CatInput input = UnpackInput(ghost->run.inputs[ghost->cursor]);
+            Entity near[GHOST_NEAR_MAX];
+            Array<Entity> movers = GhostMoversNear(job, cat, dt, ghost->time, near);
+            ghost->cursor++;
+            ghost->time += dt;
+
+            // recorded runs end in the portal or the kill zone, never past a checkpoint
+            TriggerQueue events = {};
+            CatUpdate(cat, dt, input, job->geometry, movers, job->triggers, &ghost->contact, &events, job->grid);
+            bool ended = false;
+            for (s32 e = 0; e < events.len; ++e) {
+                TriggerEvent ev = events.events[e];
+                ended |= ev.tpe == TR_ENTER && (ev.kind == TK_PORTAL || ev.kind == TK_KILL);
+            }
+            if (ended) {
+                ghost->done = true;
+                break;
+            }
+            cat->Update(dt);
+
+            // the frame advance Entity::GetFrame does while drawing, without the copy
+            Animation *ani = job->animations.arr + cat->ani_idx0 + cat->ani_idx;
+            if (cat->frame_elapsed > ani->frames[cat->frame_idx].duration) {
+                cat->frame_elapsed = 0;
+                cat->frame_idx = (cat->frame_idx + 1) % ani->frame_cnt;
+            }
+        }
+        if (ghost->cursor == ghost->run.frame_cnt) {
+            ghost->done = true;
+        }
+    }
+}
+
+#define GHOST_UPDATE_GRAIN 32
+
+// runs every ghost's recorded frames up to level_time; ghosts only read the level, so
+// they are spread over the job threads
+void GhostSetUpdate(GhostSet *set, JobSystem *jobs, f32 level_time, Array<const Entity> geometry, CollGrid *grid, TriggerSet *triggers, MoverSet *movers, Array<Entity> entities, Array<Animation> animations) {
+    GhostUpdateJob job = { set, level_time, geometry, grid, triggers, movers, entities, animations };
+    ParallelFor(jobs, set->ghosts.len, GHOST_UPDATE_GRAIN, GhostUpdateRange, &job);
+}
+
+
+// batched drawing
+
+struct GhostAtlas {
+    Texture texture;
+    f32 frame_sz;
+    f32 row_y[CAT_CNT];
+};
+
+// stacks the cat sheets into one texture, one row per CatState
+GhostAtlas GhostAtlasLoad() {
+    GhostAtlas atlas = {};
+
+    Image sheets[CAT_CNT];
+    s32 w = 0;
+    s32 h = 0;
+    for (s32 i = 0; i < CAT_CNT; ++i) {
+        sheets[i] = LoadImage(cat_sheets[i]);
+        atlas.row_y[i] = (f32) h;
+        w = sheets[i].width > w ? sheets[i].width : w;
+        h += sheets[i].height;
+    }
+    atlas.frame_sz = (f32) sheets[0].height;
+
+    Image img = GenImageColor(w, h, Color { 0, 0, 0, 0 });
+    for (s32 i = 0; i < CAT_CNT; ++i) {
+        Rectangle src = { 0, 0, (f32) sheets[i].width, (f32) sheets[i].height };
+        Rectangle dst = { 0, atlas.row_y[i], (f32) sheets[i].width, (f32) sheets[i].height };
+        ImageDraw(&img, sheets[i], src, dst, WHITE);
+        UnloadImage(sheets[i]);
+    }
+    atlas.texture = LoadTextureFromImage(img);
+    UnloadImage(img);
+
+    return atlas;
+}
+
+void GhostAtlasUnload(GhostAtlas *atlas) {
+    UnloadTexture(atlas->texture);
+    *atlas = {};
+}
+
+// all ghosts in one textured quad batch; origin is subtracted like in DrawTexturePro
+void GhostSetDraw(GhostSet *set, GhostAtlas *atlas, Vector2 origin, Color tint) {
+    if (set->cats.len == 0 || atlas->texture.id == 0) {
+        return;
+    }
+    f32 inv_w = 1.0f / atlas->texture.width;
+    f32 inv_h = 1.0f / atlas->texture.height;
+    f32 fs = atlas->frame_sz;
+
+    rlSetTexture(atlas->texture.id);
+    rlBegin(RL_QUADS);
+    rlColor4ub(tint.r, tint.g, tint.b, tint.a);
+    rlNormal3f(0.0f, 0.0f, 1.0f);
+
+    for (s32 i = 0; i < set->cats.len; ++i) {
+        if (set->ghosts.arr[i].done) {
+            continue;
+        }
+        Entity *cat = set->cats.arr + i;
+        rlCheckRenderBatchLimit(4);
+
+        f32 u0 = cat->frame_idx * fs * inv_w;
+        f32 u1 = (cat->frame_idx + 1) * fs * inv_w;
+        f32 v0 = atlas->row_y[cat->ani_idx] * inv_h;
+        f32 v1 = (atlas->row_y[cat->ani_idx] + fs) * inv_h;
+        if (cat->facing_right == false) {
+            f32 tmp = u0;
+            u0 = u1;
+            u1 = tmp;
+        }
+
+        Rectangle r = cat->ani_rect;
+        f32 x0 = r.x - origin.x;
+        f32 y0 = r.y - origin.y;
+        f32 x1 = x0 + r.width;
+        f32 y1 = y0 + r.height;
+
+        rlTexCoord2f(u0, v0); rlVertex2f(x0, y0);
+        rlTexCoord2f(u0, v1); rlVertex2f(x0, y1);
+        rlTexCoord2f(u1, v1); rlVertex2f(x1, y1);
+        rlTexCoord2f(u1, v0); rlVertex2f(x1, y0);
+    }
+
+    rlEnd();
+    rlSetTexture(0);
+}
+
+
+#endif
@@ -0,0 +1,245 @@
+#ifndef __HEADLESS_H__
+#define __HEADLESS_H__
+
+
+#include "memory.h"
+#include "input.h"
+#include "trajectory.h"
+#include "triggers.h"
+#include "entities.h"
+#include "movers.h"
+#include "levels.h"
+
+
+// Headless runs.
+//
+// A cat with its input held is advanced from event to event instead of tick by tick:
+// landing, hitting a wall, walking off a ledge, entering the portal or the kill zone.
+// Against static geometry these have closed-form times. Moving platforms and the
+// trapdoor's gate do not, so the area a mover's path covers is an event too: from
+// the moment the cat's box meets it, the run takes CatUpdate ticks like the game
+// until the box is clear again. A jump across static platforms costs a few events
+// instead of a tick every CAT_TICK_MS.
+
+
+#define HEADLESS_MOVER_MARGIN 1.0f // around a mover's path, so ticks start before contact
+
+enum CatEventType {
+    CE_NONE,
+    CE_LAND,
+    CE_WALL,
+    CE_LEDGE,
+    CE_MOVER, // the cat's box reaches where a mover can be; tick from here
+    CE_FALL_OUT,
+    CE_EXIT,
+
+    CE_CNT,
+};
+
+struct CatEvent {
+    CatEventType tpe;
+    f32 t;
+    s32 idx; // into geometry, -1 if not tied to a static entity
+};
+
+bool CatIsGrounded(const Entity *cat) {
+    return cat->accel.y == 0 && cat->velocity.y == 0;
+}
+
+CatEvent CatNextEvent(CatLevel *level, const Entity *cat, f32 max_t) {
+    CatEvent next = { CE_NONE, max_t, -1 };
+
+    Rectangle cr = cat->coll_rect;
+    Arc box = { { cr.x, cr.y }, cat->velocity, cat->accel };
+    Arc feet = CatFeetArc(cat, cat->accel.y);
+    bool grounded = CatIsGrounded(cat);
+    bool supported = false;
+
+    Array<const Entity> geometry = level->geometry;
+    for (s32 i = 0; i < geometry.len; ++i) {
+        const Entity *ent = geometry.arr + i;
+        f32 t = TOI_NONE;
+        CatEventType tpe = CE_NONE;
+
+        if (ent->tpe == ET_PLATFORM) {
+            bool standing = grounded && cat->anchor.y == ent->anchor.y + 1 && cr.x < ent->coll_rect.x + ent->coll_rect.width && cr.x + cr.width > ent->coll_rect.x;
+            if (standing) {
+                supported = true;
+                t = ArcTimeOfLeavingPlatform(box, cr.width, ent->coll_rect, max_t);
+                tpe = CE_LEDGE;
+            }
+            else if (grounded == false) {
+                t = ArcTimeOfImpactPlatform(feet, cr.width, ent->coll_rect, max_t);
+                tpe = CE_LAND;
+            }
+        }
+        else if (ent->tpe == ET_WALL_LEFT || ent->tpe == ET_WALL_RIGHT) {
+            t = ArcTimeOfImpactWall(box, cr.width, cr.height, ent->coll_rect, ent->tpe == ET_WALL_LEFT, max_t);
+            tpe = CE_WALL;
+        }
+
+        if (t != TOI_NONE && t < next.t) {
+            next = { tpe, t, i };
+        }
+    }
+
+    // at rest in mid-air, e.g. right after spawning
+    if (grounded && supported == false) {
+        next = { CE_LEDGE, 0, -1 };
+    }
+
+    Array<Entity> entities = level->entities.Items();
+    for (s32 i = 0; i < entities.len; ++i) {
+        const Entity *ent = entities.arr + i;
+        if ((ent->flags & EF_KINEMATIC) == 0) {
+            continue;
+        }
+        f32 t = ArcTimeOfEnteringRect(box, cr.width, cr.height, MoverPathRect(&level->movers, ent, HEADLESS_MOVER_MARGIN), next.t);
+        if (t != TOI_NONE && t <= next.t) {
+            next = { CE_MOVER, t, -1 };
+        }
+    }
+
+    // the kill zone from its top, like the cat's cells see it; the portal by its cells
+    Array<TriggerVolume> volumes = level->triggers.volumes;
+    for (s32 i = 0; i < volumes.len; ++i) {
+        TriggerVolume *vol = volumes.arr + i;
+        f32 t = TOI_NONE;
+        CatEventType tpe = CE_NONE;
+        if (vol->kind == TK_KILL && grounded == false) {
+            t = SolveCrossingIncreasing(cat->anchor.y, cat->velocity.y, cat->accel.y, vol->span.r0 * TRIGGER_CELL);
+            tpe = CE_FALL_OUT;
+        }
+        else if (vol->kind == TK_PORTAL) {
+            t = ArcTimeOfEnteringRect(box, cr.width, cr.height, TriggerSpanRect(vol->span), next.t);
+            tpe = CE_EXIT;
+        }
+        if (t != TOI_NONE && t <= next.t) {
+            next = { tpe, t, -1 };
+        }
+    }
+    return next;
+}
+
+void CatResolveEvent(CatLevel *level, Entity *cat, CatEvent ev) {
+    if (ev.tpe == CE_LAND) {
+        const Entity *ent = level->geometry.arr + ev.idx;
+        cat->anchor.y = ent->anchor.y + 1;
+        cat->velocity.y = 0;
+        cat->accel.y = 0;
+    }
+    else if (ev.tpe == CE_WALL) {
+        const Entity *ent = level->geometry.arr + ev.idx;
+        if (ent->tpe == ET_WALL_LEFT) {
+            cat->anchor.x = ent->anchor.x + cat->coll_rect.width / 2 - 2;
+        }
+        else {
+            cat->anchor.x = ent->anchor.x - cat->coll_rect.width / 2 - 5;
+        }
+        cat->velocity.x = 0;
+    }
+    else if (ev.tpe == CE_LEDGE) {
+        cat->accel.y = CAT_GRAVITY;
+    }
+    cat->Update(0);
+}
+
+// Advances to the next event, or max_t, and resolves it the way CatUpdate would.
+// Input is held: the cat jumps whenever it stands, and stays put against a wall it
+// runs into. Returns a CE_MOVER at t = 0 without moving the cat; the caller ticks
+// it with CatUpdate instead.
+CatEvent CatAdvanceToNextEvent(CatLevel *level, Entity *cat, CatInput input, f32 max_t) {
+    CatSteer(cat, input);
+    CatEvent ev = CatNextEvent(level, cat, max_t);
+
+    // against a wall, where hitting it would put the cat anyway
+    if (ev.tpe == CE_WALL) {
+        Entity at = *cat;
+        CatResolveEvent(level, &at, ev);
+        if (ev.t == 0 || at.anchor.x == cat->anchor.x) {
+            *cat = at;
+            ev = CatNextEvent(level, cat, max_t);
+        }
+    }
+    if (ev.tpe == CE_MOVER && ev.t == 0) {
+        return ev;
+    }
+
+    bool standing = CatIsGrounded(cat) && (ev.tpe != CE_LEDGE || ev.idx >= 0);
+    if (input.jump && standing) {
+        cat->velocity.y = -1.0f * CAT_JUMP_SPEED;
+        cat->accel.y = CAT_GRAVITY;
+        cat->anchor.y += -2;
+        cat->Update(0);
+        ev = CatNextEvent(level, cat, max_t);
+    }
+    cat->Update(ev.t);
+    CatResolveEvent(level, cat, ev);
+
+    return ev;
+}
+
+struct HeadlessRun {
+    CatEventType end; // CE_FALL_OUT, CE_EXIT, or CE_NONE when the time ran out
+    f64 time;
+    s32 events;
+    s32 ticks;
+    f32 top; // the highest the cat stood
+};
+
+// runs the level's cat from the spawn for up to max_time ms, holding input
+HeadlessRun RunHeadless(CatLevel *level, CatInput input, f64 max_time) {
+    Entity *cat = level->entities.Get(level->cat);
+    cat->anchor = level->spawn;
+    cat->velocity = {};
+    cat->accel = {};
+    cat->Update(0);
+
+    Array<Entity> entities = level->entities.Items();
+    for (s32 i = 0; i < entities.len; ++i) {
+        entities.arr[i].flags &= ~EF_ASLEEP;
+    }
+    UpdateMovers(&level->movers, entities, 0);
+    TriggerContact contact = InitTriggerContact();
+    TriggerQueue events = {};
+
+    HeadlessRun run = { CE_NONE, 0, 0, 0, cat->anchor.y };
+    while (run.time < max_time && run.end == CE_NONE) {
+        CatEvent ev = CatAdvanceToNextEvent(level, cat, input, (f32) (max_time - run.time));
+
+        if (ev.tpe == CE_MOVER && ev.t == 0) {
+            // near something that moves, a tick like the game's
+            UpdateMovers(&level->movers, entities, run.time);
+            TriggerQueueClear(&events);
+            u32 coll = CatUpdate(cat, CAT_TICK_MS, input, level->geometry, entities, &level->triggers, &contact, &events, &level->grid);
+            if (coll & CC_PLATFORM) {
+                run.top = cat->anchor.y < run.top ? cat->anchor.y : run.top;
+            }
+            cat->Update(CAT_TICK_MS);
+            run.time += CAT_TICK_MS;
+            run.ticks++;
+            for (s32 i = 0; i < events.len; ++i) {
+                if (events.events[i].tpe == TR_ENTER && events.events[i].kind == TK_KILL) {
+                    run.end = CE_FALL_OUT;
+                }
+                else if (events.events[i].tpe == TR_ENTER && events.events[i].kind == TK_PORTAL) {
+                    run.end = CE_EXIT;
+                }
+            }
+        }
+        else {
+            run.time += ev.t;
+            run.events++;
+            if (ev.tpe == CE_FALL_OUT || ev.tpe == CE_EXIT) {
+                run.end = ev.tpe;
+            }
+            else if (ev.tpe == CE_LAND) {
+                run.top = cat->anchor.y < run.top ? cat->anchor.y : run.top;
+            }
+        }
+    }
+    return run;
+}
+
+
+#endif
@@ -34,4 +34,33 @@ bool DoJump() {
     return key_space;
 }
 
+// the inputs that drive one CatUpdate tick, as plain data so they can be recorded,
+// sent to a peer, predicted and replayed
+
+struct CatInput {
+    bool left;
+    bool right;
+    bool jump;
+};
+
+CatInput PollInput() {
+    CatInput input = {};
+    input.left = DoMoveLeft();
+    input.right = DoMoveRight();
+    input.jump = DoJump();
+    return input;
+}
+
+u8 PackInput(CatInput input) {
+    return (u8) ((input.left << 0) | (input.right << 1) | (input.jump << 2));
+}
+
+CatInput UnpackInput(u8 bits) {
+    CatInput input = {};
+    input.left = (bits & (1 << 0)) != 0;
+    input.right = (bits & (1 << 1)) != 0;
+    input.jump = (bits & (1 << 2)) != 0;
+    return input;
+}
+
 #endif
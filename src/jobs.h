@@ -0,0 +1,229 @@
+#ifndef __JOBS_H__
+#define __JOBS_H__
+
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+#include "memory.h"
+
+
+// Jobs.
+//
+// A job is a function over an index range. Every thread, the main thread included,
+// owns a deque: it pushes and pops its own jobs at the bottom, and idle threads steal
+// from the top of the others. Waiting on a counter runs jobs instead of blocking, so
+// the waiting thread helps finish the work it depends on, and nested ParallelFor
+// calls from inside jobs cannot deadlock.
+//
+// With a single thread, or on the web build, everything runs inline on the caller.
+
+
+#define JOB_MAX_THREADS 32
+#define JOB_DEQUE_CAP 1024
+
+typedef void (*JobFunc)(void *data, s32 lo, s32 hi);
+
+// number of jobs still to finish; counters are shared by a group of jobs
+struct JobCounter {
+    std::atomic<s32> pending;
+};
+
+struct Job {
+    JobFunc fn;
+    void *data;
+    s32 lo;
+    s32 hi;
+    JobCounter *counter;
+};
+
+struct JobDeque {
+    std::mutex lock;
+    Job jobs[JOB_DEQUE_CAP];
+    s32 top; // thieves take from here
+    s32 bottom; // the owner pushes and pops here
+};
+
+struct JobSystem {
+    s32 thread_cnt; // including the main thread
+    JobDeque deques[JOB_MAX_THREADS];
+    std::thread workers[JOB_MAX_THREADS];
+
+    std::atomic<s32> queued;
+    std::atomic<bool> quit;
+    std::mutex sleep_lock;
+    std::condition_variable sleep_cv;
+};
+
+// 0 on the main thread, 1.. on the workers
+thread_local s32 job_thread_idx = 0;
+
+s32 JobThreadIndex() {
+    return job_thread_idx;
+}
+
+s32 JobDefaultThreadCount() {
+#ifdef __EMSCRIPTEN__
+    return 1;
+#else
+    s32 n = (s32) std::thread::hardware_concurrency();
+    n = n < 1 ? 1 : n;
+    return n > JOB_MAX_THREADS ? JOB_MAX_THREADS : n;
+#endif
+}
+
+
+// deques
+
+bool JobDequePush(JobDeque *dq, Job job) {
+    std::lock_guard<std::mutex> guard(dq->lock);
+    if (dq->bottom - dq->top == JOB_DEQUE_CAP) {
+        return false;
+    }
+    dq->jobs[dq->bottom % JOB_DEQUE_CAP] = job;
+    dq->bottom++;
+    return true;
+}
+
+bool JobDequePop(JobDeque *dq, Job *out) {
+    std::lock_guard<std::mutex> guard(dq->lock);
+    if (dq->bottom == dq->top) {
+        return false;
+    }
+    dq->bottom--;
+    *out = dq->jobs[dq->bottom % JOB_DEQUE_CAP];
+    return true;
+}
+
+bool JobDequeSteal(JobDeque *dq, Job *out) {
+    std::lock_guard<std::mutex> guard(dq->lock);
+    if (dq->bottom == dq->top) {
+        return false;
+    }
+    *out = dq->jobs[dq->top % JOB_DEQUE_CAP];
+    dq->top++;
+    return true;
+}
+
+
+// scheduling
+
+void JobExecute(Job job) {
+    job.fn(job.data, job.lo, job.hi);
+    job.counter->pending.fetch_sub(1, std::memory_order_release);
+}
+
+// own deque first, then the others round-robin from our neighbour
+bool JobTake(JobSystem *js, s32 idx, Job *out) {
+    if (js->queued.load(std::memory_order_relaxed) == 0) {
+        return false;
+    }
+    bool ok = JobDequePop(js->deques + idx, out);
+    for (s32 i = 1; i < js->thread_cnt && ok == false; ++i) {
+        ok = JobDequeSteal(js->deques + (idx + i) % js->thread_cnt, out);
+    }
+    if (ok) {
+        js->queued.fetch_sub(1);
+    }
+    return ok;
+}
+
+void JobWakeWorkers(JobSystem *js) {
+    {
+        std::lock_guard<std::mutex> guard(js->sleep_lock);
+    }
+    js->sleep_cv.notify_all();
+}
+
+// queues fn over [lo, hi) on this thread's deque; runs it right away if the deque is full
+void JobPush(JobSystem *js, JobFunc fn, void *data, s32 lo, s32 hi, JobCounter *counter) {
+    counter->pending.fetch_add(1, std::memory_order_relaxed);
+    Job job = { fn, data, lo, hi, counter };
+
+    if (js->thread_cnt > 1 && JobDequePush(js->deques + JobThreadIndex(), job)) {
+        js->queued.fetch_add(1);
+        return;
+    }
+    JobExecute(job);
+}
+
+// runs queued jobs until the counter drops to zero
+void JobWait(JobSystem *js, JobCounter *counter) {
+    while (counter->pending.load(std::memory_order_acquire) > 0) {
+        Job job = {};
+        if (JobTake(js, JobThreadIndex(), &job)) {
+            JobExecute(job);
+        }
+        else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+// fn over [0, cnt) in chunks of grain indices; returns when all of them are done
+void ParallelFor(JobSystem *js, s32 cnt, s32 grain, JobFunc fn, void *data) {
+    if (cnt <= 0) {
+        return;
+    }
+    grain = grain < 1 ? 1 : grain;
+    if (js == NULL || js->thread_cnt == 1 || cnt <= grain) {
+        fn(data, 0, cnt);
+        return;
+    }
+
+    JobCounter counter;
+    counter.pending.store(0, std::memory_order_relaxed);
+    for (s32 lo = 0; lo < cnt; lo += grain) {
+        s32 hi = lo + grain < cnt ? lo + grain : cnt;
+        JobPush(js, fn, data, lo, hi, &counter);
+    }
+    JobWakeWorkers(js);
+    JobWait(js, &counter);
+}
+
+
+// workers
+
+void JobWorkerMain(JobSystem *js, s32 idx) {
+    job_thread_idx = idx;
+
+    while (js->quit.load() == false) {
+        Job job = {};
+        if (JobTake(js, idx, &job)) {
+            JobExecute(job);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(js->sleep_lock);
+        js->sleep_cv.wait(lock, [js] { return js->queued.load() > 0 || js->quit.load(); });
+    }
+}
+
+void JobSystemInit(JobSystem *js, s32 thread_cnt) {
+#ifdef __EMSCRIPTEN__
+    thread_cnt = 1;
+#endif
+    thread_cnt = thread_cnt < 1 ? 1 : thread_cnt;
+    thread_cnt = thread_cnt > JOB_MAX_THREADS ? JOB_MAX_THREADS : thread_cnt;
+
+    js->thread_cnt = thread_cnt;
+    js->queued.store(0);
+    js->quit.store(false);
+    for (s32 i = 1; i < thread_cnt; ++i) {
+        js->workers[i] = std::thread(JobWorkerMain, js, i);
+    }
+}
+
+void JobSystemShutdown(JobSystem *js) {
+    js->quit.store(true);
+    JobWakeWorkers(js);
+    for (s32 i = 1; i < js->thread_cnt; ++i) {
+        js->workers[i].join();
+    }
+    js->thread_cnt = 1;
+}
+
+
+#endif
@@ -0,0 +1,230 @@
+#ifndef __LEVELGEN_H__
+#define __LEVELGEN_H__
+
+
+#include <cstdio>
+
+#include "memory.h"
+#include "jobs.h"
+#include "trajectory.h"
+#include "entities.h"
+#include "levels.h"
+
+
+// Procedural levels.
+//
+// A generated level is a climb: a ground platform, then platforms stacked upwards,
+// each within reach of the one below it. Reach comes from the cat's jump arc, so
+// every level is playable by construction. The same seed always gives the same
+// level, and the geometry goes into the caller's arena in one block.
+
+
+struct LevelGenParams {
+    u64 seed;
+    s32 platform_cnt; // not counting the ground
+    f32 difficulty; // 0 is easy, 1 puts jumps right at the edge of the envelope
+    f32 mover_ratio; // fraction of the platforms that swing sideways
+    s32 checkpoint_every; // static platforms from one checkpoint to the next, 0 for none
+};
+
+// splitmix64; small, fast and good enough to lay out platforms
+struct LevelRng {
+    u64 state;
+
+    u64 Next() {
+        u64 z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+    f32 Range(f32 lo, f32 hi) {
+        f32 u = (Next() >> 40) * (1.0f / (1 << 24));
+        return lo + (hi - lo) * u;
+    }
+};
+
+// what a single jump from a platform can reach
+struct JumpEnvelope {
+    f32 rise; // highest landing above the take-off
+    f32 reach; // horizontal distance covered when landing at that height
+};
+
+// margin keeps landings clear of the apex, where the arc is too flat to steer onto
+JumpEnvelope GetJumpEnvelope(f32 margin) {
+    JumpEnvelope env = {};
+    f32 apex = CAT_JUMP_SPEED * CAT_JUMP_SPEED / (2 * CAT_GRAVITY);
+    env.rise = apex * margin;
+
+    // time to come back down onto a platform at that height
+    f32 t = SolveCrossingIncreasing(0, - CAT_JUMP_SPEED, CAT_GRAVITY, - env.rise);
+    assert(t != TOI_NONE);
+    env.reach = CAT_RUN_SPEED * t;
+
+    return env;
+}
+
+#define LEVELGEN_GROUND_ROW 3
+
+// what GenerateLevel takes from its arena, its four allocations padded
+u64 LevelGenArenaSize(LevelGenParams params) {
+    s32 mover_cap = (s32) (params.platform_cnt * params.mover_ratio * 1.5f) + 8;
+    s32 checkpoint_cap = params.checkpoint_every > 0 ? params.platform_cnt / params.checkpoint_every : 0;
+    return sizeof(Entity) * (params.platform_cnt + 3) + sizeof(LevelMover) * mover_cap + sizeof(Vector2) * checkpoint_cap + 32 + 4 * ARENA_ALIGN;
+}
+
+// geometry is the two column walls, the ground and then the static platforms, bottom up
+LevelDesc GenerateLevel(MArena *a, LevelGenParams params) {
+    assert(params.platform_cnt >= 0);
+
+    LevelRng rng = { params.seed };
+    f32 diff = params.difficulty < 0 ? 0 : (params.difficulty > 1 ? 1 : params.difficulty);
+    JumpEnvelope env = GetJumpEnvelope(0.85f);
+
+    // spacing and widths shrink towards the envelope limit as difficulty goes up
+    f32 rise_lo = 0.5f * grid_h;
+    f32 rise_hi = rise_lo + (env.rise - rise_lo) * (0.5f + 0.5f * diff);
+    f32 gap_hi = env.reach * (0.25f + 0.6f * diff);
+    f32 width_lo = grid_w * (1.5f - 1.0f * diff);
+    f32 width_hi = grid_w * (3.0f - 1.5f * diff);
+
+    s32 cnt = 3;
+    Entity *geometry = (Entity*) ArenaAlloc(a, sizeof(Entity) * (params.platform_cnt + 3), false);
+    s32 mover_cap = (s32) (params.platform_cnt * params.mover_ratio * 1.5f) + 8;
+    LevelMover *movers = (LevelMover*) ArenaAlloc(a, sizeof(LevelMover) * mover_cap, false);
+    s32 mover_cnt = 0;
+    s32 checkpoint_cap = params.checkpoint_every > 0 ? params.platform_cnt / params.checkpoint_every : 0;
+    Vector2 *checkpoints = (Vector2*) ArenaAlloc(a, sizeof(Vector2) * checkpoint_cap, false);
+    s32 checkpoint_cnt = 0;
+
+    Vector2 ground = GetGridAnchor(0, LEVELGEN_GROUND_ROW);
+    geometry[2] = InitPlatform(ground, col_width);
+
+    f32 x = 0;
+    f32 y = ground.y;
+    f32 w = col_width;
+    for (s32 i = 0; i < params.platform_cnt; ++i) {
+        f32 next_w = rng.Range(width_lo, width_hi);
+
+        // horizontally, anywhere that leaves a gap of at most gap_hi to the last platform
+        f32 lo = x - gap_hi - next_w;
+        f32 hi = x + w + gap_hi;
+        lo = lo < 0 ? 0 : lo;
+        hi = hi > col_width - next_w ? col_width - next_w : hi;
+
+        x = rng.Range(lo, hi);
+        y -= rng.Range(rise_lo, rise_hi);
+        w = next_w;
+
+        // a mover swings around where a static platform would be, within the column,
+        // so there is always a moment it is in reach
+        if (mover_cnt < mover_cap && rng.Range(0, 1) < params.mover_ratio) {
+            f32 amp = grid_w;
+            amp = x < amp ? x : amp;
+            amp = col_width - w - x < amp ? col_width - w - x : amp;
+            f32 period = rng.Range(2000, 4000);
+            f32 phase = rng.Range(0, 1);
+            movers[mover_cnt++] = { InitMovingPlatform({ x, y }, w), InitSinePath({ x, y }, { amp, 0 }, period, phase) };
+        }
+        else {
+            geometry[cnt++] = InitPlatform({ x, y }, w);
+
+            // on every checkpoint_every-th, the ground and the walls not counted
+            if (checkpoint_cnt < checkpoint_cap && (cnt - 3) % params.checkpoint_every == 0) {
+                checkpoints[checkpoint_cnt++] = { x + w / 2, y };
+            }
+        }
+    }
+
+    // the column walls run from the ground to well above the last platform
+    f32 wall_top = y - 1024;
+    f32 wall_h = CAT_FALL_OUT_Y - wall_top;
+    geometry[0] = InitWall({ 0, wall_top }, wall_h, true);
+    geometry[1] = InitWall({ col_width, wall_top }, wall_h, false);
+
+    char *name = (char*) ArenaAlloc(a, 32);
+    snprintf(name, 32, "gen_%08llx", (unsigned long long) (params.seed & 0xFFFFFFFF));
+
+    // portal stands on the last platform, the trapdoor marks the start
+    Vector2 portal = { x + w / 2 - grid_w / 2, y - grid_h };
+    portal.x = portal.x < 0 ? 0 : (portal.x > col_width - grid_w ? col_width - grid_w : portal.x);
+
+    LevelDesc desc = {};
+    desc.name = name;
+    desc.trapdoor = GetGridAnchor(0, LEVELGEN_GROUND_ROW - 3);
+    desc.spawn = GetTrapdoorSpawn(desc.trapdoor);
+    desc.portal = portal;
+    desc.geometry = geometry;
+    desc.geometry_cnt = cnt;
+    desc.movers = movers;
+    desc.mover_cnt = mover_cnt;
+    desc.checkpoints = checkpoints;
+    desc.checkpoint_cnt = checkpoint_cnt;
+
+    return desc;
+}
+
+// FNV-1a over what makes up a generated level, for telling levels apart; entities
+// are hashed field by field, their padding is whatever the stack had
+u64 LevelHashBytes(u64 h, const void *data, u64 len) {
+    const u8 *b = (const u8*) data;
+    for (u64 i = 0; i < len; ++i) {
+        h = (h ^ b[i]) * 0x100000001B3ull;
+    }
+    return h;
+}
+
+u64 LevelHashEntity(u64 h, const Entity *ent) {
+    h = LevelHashBytes(h, &ent->tpe, sizeof(ent->tpe));
+    h = LevelHashBytes(h, &ent->anchor, sizeof(ent->anchor));
+    return LevelHashBytes(h, &ent->coll_rect, sizeof(ent->coll_rect));
+}
+
+u64 LevelDescHash(const LevelDesc *desc) {
+    u64 h = 0xCBF29CE484222325ull;
+    h = LevelHashBytes(h, &desc->spawn, sizeof(desc->spawn));
+    h = LevelHashBytes(h, &desc->trapdoor, sizeof(desc->trapdoor));
+    h = LevelHashBytes(h, &desc->portal, sizeof(desc->portal));
+    for (s32 i = 0; i < desc->geometry_cnt; ++i) {
+        h = LevelHashEntity(h, desc->geometry + i);
+    }
+    for (s32 i = 0; i < desc->mover_cnt; ++i) {
+        const MoverPath *path = &desc->movers[i].path;
+        h = LevelHashEntity(h, &desc->movers[i].ent);
+        h = LevelHashBytes(h, &path->origin, sizeof(path->origin));
+        h = LevelHashBytes(h, &path->amplitude, sizeof(path->amplitude));
+        h = LevelHashBytes(h, &path->period, sizeof(path->period));
+        h = LevelHashBytes(h, &path->phase, sizeof(path->phase));
+    }
+    return LevelHashBytes(h, desc->checkpoints, sizeof(Vector2) * desc->checkpoint_cnt);
+}
+
+
+// batches
+
+struct LevelGenBatchJob {
+    LevelGenParams params;
+    LevelDesc *out;
+    MArena *arenas;
+};
+
+void LevelGenRange(void *data, s32 lo, s32 hi) {
+    LevelGenBatchJob *job = (LevelGenBatchJob*) data;
+    MArena *a = job->arenas + JobThreadIndex();
+    for (s32 i = lo; i < hi; ++i) {
+        LevelGenParams p = job->params;
+        p.seed = job->params.seed + i;
+        job->out[i] = GenerateLevel(a, p);
+    }
+}
+
+// Generates cnt levels, seeds params.seed + i, over the job threads. Each thread
+// writes into its own arena, so arenas must hold one per job thread; level i lives in
+// whichever arena its thread had. An arena of LevelGenArenaSize * cnt is always
+// enough. See tools/catjump_levelgen.
+void GenerateLevelBatch(JobSystem *jobs, LevelGenParams params, LevelDesc *out, s32 cnt, MArena *arenas) {
+    LevelGenBatchJob job = { params, out, arenas };
+    ParallelFor(jobs, cnt, 1, LevelGenRange, &job);
+}
+
+
+#endif
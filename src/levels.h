@@ -3,16 +3,42 @@
 
 
 #include "entities.h"
+#include "collgrid.h"
+#include "movers.h"
+#include "activity.h"
 
 
 struct CatLevel {
     const char *name;
-    Entity *cat;
-    Entity *portal;
-    Entity *trapdoor;
-    Array<Entity> entities;
+    Handle cat;
+    Handle portal;
+    Handle trapdoor;
+    Vector2 spawn;
+    f32 top; // highest platform, for scrolling tall levels
+    Array<const Entity> geometry; // static platforms and walls, read-only
+    CollGrid grid; // over geometry
+    TriggerSet triggers;
+    MoverSet movers;
+    Pool<Entity> entities;
+    ActivityRegions activity; // over entities
 };
 
+// transient entities come and go through the pool, the level keeps only handles
+
+Handle SpawnEntity(CatLevel *level, Entity ent) {
+    Handle h = level->entities.Add(ent);
+    ActivityAdd(&level->activity, &level->movers, &level->entities, h);
+    return h;
+}
+
+bool DespawnEntity(CatLevel *level, Handle h) {
+    if (level->entities.IsValid(h) == false) {
+        return false;
+    }
+    ActivityRemove(&level->activity, h);
+    return level->entities.Remove(h);
+}
+
 Entity InitCatEntity(s32 frame_sz) {
     Entity cat = {};
     cat.tpe = ET_CAT;
@@ -39,8 +65,11 @@ Entity InitTrapdoorEntity(s32 frame_sz) {
     trapdoor.ani_idx = 0;
     trapdoor.ani_idx0 = 0;
     trapdoor.velocity = {};
-    trapdoor.coll_offset = {};
-    trapdoor.coll_rect = {};
+    trapdoor.flags = EF_KINEMATIC;
+
+    // the door is the bottom edge, a floor while closed
+    trapdoor.coll_offset = { 0, (f32) frame_sz * SPRITE_SCALE - 2 };
+    trapdoor.coll_rect = { 0, 0, (f32) frame_sz * SPRITE_SCALE, 2 };
     trapdoor.ani_offset = {};
     trapdoor.ani_rect = { 0, 0, (f32) frame_sz * SPRITE_SCALE, (f32) frame_sz * SPRITE_SCALE };
 
@@ -64,241 +93,421 @@ Entity InitPortalEntity(s32 frame_sz) {
     return portal;
 }
 
-Array<Animation> LoadAnimations(MArena *a, s32 cap) {
+// one sheet per CatState, in order
+const char *cat_sheets[CAT_CNT] = {
+    "resources/1_Cat_Idle-Sheet.png",
+    "resources/2_Cat_Run-Sheet.png",
+    "resources/3_Cat_Jump-Sheet.png",
+    "resources/4_Cat_Fall-Sheet.png",
+};
+
+struct AnimationSource {
+    const char *file;
+    EntityType tpe;
+};
+
+struct ImageDecodeJob {
+    AnimationSource *sources;
+    Image *images;
+};
+
+void ImageDecodeRange(void *data, s32 lo, s32 hi) {
+    ImageDecodeJob *job = (ImageDecodeJob*) data;
+    for (s32 i = lo; i < hi; ++i) {
+        job->images[i] = LoadImage(job->sources[i].file);
+    }
+}
+
+// sheets are decoded on all threads, textures can only be created on the main one
+Array<Animation> LoadAnimations(MArena *a, s32 cap, JobSystem *jobs) {
     Array<Animation> animations = InitArray<Animation>(a, 64);
     animations.len = 1;
 
-    animations.Add( InitAnimation("resources/1_Cat_Idle-Sheet.png", ET_CAT) );
-    animations.Add( InitAnimation("resources/2_Cat_Run-Sheet.png", ET_CAT) );
-    animations.Add( InitAnimation("resources/3_Cat_Jump-Sheet.png", ET_CAT) );
-    animations.Add( InitAnimation("resources/4_Cat_Fall-Sheet.png", ET_CAT) );
-    animations.Add( InitAnimation("resources/portal.png", ET_PORTAL) );
-    animations.Add( InitAnimation("resources/trapdoor.png", ET_TRAPDOOR) );
+    AnimationSource sources[CAT_CNT + 2];
+    for (s32 i = 0; i < CAT_CNT; ++i) {
+        sources[i] = { cat_sheets[i], ET_CAT };
+    }
+    sources[CAT_CNT] = { "resources/portal.png", ET_PORTAL };
+    sources[CAT_CNT + 1] = { "resources/trapdoor.png", ET_TRAPDOOR };
+
+    s32 cnt = ArrayLen(sources);
+    Image images[ArrayLen(sources)];
+    ImageDecodeJob job = { sources, images };
+    ParallelFor(jobs, cnt, 1, ImageDecodeRange, &job);
+
+    for (s32 i = 0; i < cnt; ++i) {
+        animations.Add( InitAnimationFromTexture(LoadTextureFromImage(images[i]), sources[i].tpe) );
+        UnloadImage(images[i]);
+    }
 
     return animations;
 }
 
-void LoadLevelDefaults(CatLevel *level, Array<Animation> animations) {
+// the dynamic entities every level starts with, built once after the animations load
+
+struct LevelDefaults {
+    Entity cat;
+    Entity portal;
+    Entity trapdoor;
+};
+
+LevelDefaults InitLevelDefaults(Array<Animation> animations) {
     s32 frame_sz = animations.arr[1].frame_sz;
 
-    level->cat = level->entities.Add( InitCatEntity(frame_sz) );
-    level->portal = level->entities.Add( InitPortalEntity(frame_sz) );
-    level->trapdoor = level->entities.Add( InitTrapdoorEntity(frame_sz) );
+    LevelDefaults defaults = {};
+    defaults.cat = InitCatEntity(frame_sz);
+    defaults.portal = InitPortalEntity(frame_sz);
+    defaults.trapdoor = InitTrapdoorEntity(frame_sz);
+
+    Entity *cat = &defaults.cat;
+    Entity *portal = &defaults.portal;
+    Entity *trapdoor = &defaults.trapdoor;
 
     for (s32 i = 0; i < animations.len; ++i) {
         Animation ani = animations.arr[i];
 
         if (ani.tpe == ET_CAT) {
-            if (level->cat->ani_idx0 == 0) {
-                level->cat->ani_idx0 = i;
+            if (cat->ani_idx0 == 0) {
+                cat->ani_idx0 = i;
             }
-            level->cat->ani_cnt++;
+            cat->ani_cnt++;
         }
         else if (ani.tpe == ET_PORTAL) {
-            if (level->portal->ani_idx0 == 0) {
-                level->portal->ani_idx0 = i;
+            if (portal->ani_idx0 == 0) {
+                portal->ani_idx0 = i;
             }
-            level->portal->ani_cnt++;
+            portal->ani_cnt++;
         }
         else if (ani.tpe == ET_TRAPDOOR) {
-            if (level->trapdoor->ani_idx0 == 0) {
-                level->trapdoor->ani_idx0 = i;
+            if (trapdoor->ani_idx0 == 0) {
+                trapdoor->ani_idx0 = i;
             }
-            level->trapdoor->ani_cnt++;
+            trapdoor->ani_cnt++;
         }
     }
+    return defaults;
 }
 
-f32 col_width = 896;
-f32 grid_w = 32 * SPRITE_SCALE;
-f32 grid_h = 32 * SPRITE_SCALE;
-s32 grid_w_max = col_width / grid_w;
-
-Vector2 GetGridAnchor(f32 x, f32 y) {
-    Vector2 anch = { x * grid_w, y * grid_h };
-    return anch;
+void LoadLevelDefaults(CatLevel *level, LevelDefaults *defaults) {
+    level->cat = level->entities.Add(defaults->cat);
+    level->portal = level->entities.Add(defaults->portal);
+    level->trapdoor = level->entities.Add(defaults->trapdoor);
 }
 
-void LoadColumnWalls(Array<Entity> *entities) {
-    entities->Add( InitWall( { 0, -1024 }, 4056, true) );
-    entities->Add( InitWall( { col_width, -1024 }, 4056, false) );
-}
+constexpr f32 col_width = 896;
+constexpr f32 grid_w = 32 * SPRITE_SCALE;
+constexpr f32 grid_h = 32 * SPRITE_SCALE;
+constexpr s32 grid_w_max = col_width / grid_w;
 
-CatLevel LoadLevel00(MArena *a, Array<Animation> animations) {
-    CatLevel level = {};
-    level.entities = InitArray<Entity>(a, 64);
-    LoadLevelDefaults(&level, animations);
-    LoadColumnWalls(&level.entities);
+static_assert(COLLGRID_X0 + COLLGRID_COLS * COLLGRID_CELL > col_width + 2, "the column must fit in one collision grid row");
+static_assert(TRIGGER_X0 + TRIGGER_COLS * TRIGGER_CELL > col_width + 2, "the column must fit in one trigger row");
+static_assert(CAT_FALL_OUT_Y % (s32) TRIGGER_CELL == 0, "the kill zone starts where the cat's cells say it does");
 
-    level.trapdoor->anchor = GetGridAnchor(0, 0);
-    level.portal->anchor = GetGridAnchor(grid_w_max - 1, 2);
+constexpr Vector2 GetGridAnchor(f32 x, f32 y) {
+    Vector2 anch = { x * grid_w, y * grid_h };
+    return anch;
+}
 
-    level.entities.Add( InitPlatform( GetGridAnchor(0, 3), grid_w_max * grid_w ) );
+// for tools that run levels without a window: no sprites, and frames the size of a
+// grid cell, like the sheets'
+LevelDefaults InitHeadlessLevelDefaults() {
+    s32 frame_sz = (s32) (grid_w / SPRITE_SCALE);
 
-    return level;
+    LevelDefaults defaults = {};
+    defaults.cat = InitCatEntity(frame_sz);
+    defaults.portal = InitPortalEntity(frame_sz);
+    defaults.trapdoor = InitTrapdoorEntity(frame_sz);
+    return defaults;
 }
 
-CatLevel LoadLevel01(MArena *a, Array<Animation> animations) {
-    CatLevel level = {};
-    level.entities = InitArray<Entity>(a, 64);
-    LoadLevelDefaults(&level, animations);
-    LoadColumnWalls(&level.entities);
-
-    level.trapdoor->anchor = GetGridAnchor(0, 0);
-    level.portal->anchor = GetGridAnchor(grid_w_max - 1, 2);
+// the cat starts standing on the trapdoor's door, inside it, and drops through once
+// it opens
+constexpr Vector2 GetTrapdoorSpawn(Vector2 trapdoor) {
+    Vector2 spawn = { trapdoor.x + grid_w / 2, trapdoor.y + grid_h - 1 };
+    return spawn;
+}
 
-    level.entities.Add( InitPlatform( GetGridAnchor(0, 3), grid_w * 2.5 ) );
-    level.entities.Add( InitPlatform( GetGridAnchor(4.5, 3), grid_w * 2.5 ) );
 
-    return level;
-}
+// Built-in levels are constexpr tables. Their geometry (platforms and walls) is
+// evaluated at compile time, lives in read-only data and is pointed at directly
+// by the loaded level; only the cat, portal and trapdoor are copied into its pool.
 
-CatLevel LoadLevel02(MArena *a, Array<Animation> animations) {
-    CatLevel level = {};
-    level.entities = InitArray<Entity>(a, 64);
-    LoadLevelDefaults(&level, animations);
-    LoadColumnWalls(&level.entities);
+#define LEVEL_COLUMN_WALLS \
+    InitWall( { 0, -1024 }, 4056, true), \
+    InitWall( { col_width, -1024 }, 4056, false)
 
-    level.trapdoor->anchor = GetGridAnchor(0, 0);
-    level.portal->anchor = GetGridAnchor(grid_w_max - 1, 5);
+struct LevelDesc {
+    const char *name;
+    Vector2 spawn;
+    Vector2 trapdoor;
+    Vector2 portal;
+    const Entity *geometry;
+    s32 geometry_cnt;
+    const LevelMover *movers;
+    s32 mover_cnt;
+    const MoverKey *keys; // for MP_KEYS movers, their key_first indexes these
+    s32 key_cnt;
+    const Vector2 *checkpoints; // where the cat stands at each
+    s32 checkpoint_cnt;
+};
 
-    level.entities.Add( InitPlatform( GetGridAnchor(0, 3), grid_w * 2.5 ) );
-    level.entities.Add( InitPlatform( GetGridAnchor(4.5, 3), grid_w * 2.5 ) );
-    level.entities.Add( InitPlatform( GetGridAnchor(0, 6), grid_w * 2.5 ) );
-    level.entities.Add( InitPlatform( GetGridAnchor(4.5, 6), grid_w * 2.5 ) );
+// the trapdoor lets the cat drop in at the start and shuts after TRAPDOOR_OPEN_MS; the
+// same for every runner, so ghosts replay against the gate they recorded with
+#define TRAPDOOR_OPEN_MS 400
+
+// a checkpoint's volume stands on the platform around where the cat comes back
+#define CHECKPOINT_W (grid_w / 2)
+#define CHECKPOINT_H grid_h
+
+// rejects platforms that stick out of the column or overlap another platform
+constexpr bool ValidateGeometry(const Entity *geometry, s32 cnt) {
+    f32 eps = 0.5f;
+    for (s32 i = 0; i < cnt; ++i) {
+        const Entity &p = geometry[i];
+        if (p.tpe != ET_PLATFORM) {
+            continue;
+        }
+        if (p.anchor.x < -eps || p.anchor.x + p.coll_rect.width > col_width + eps) {
+            return false;
+        }
 
-    return level;
+        for (s32 j = i + 1; j < cnt; ++j) {
+            const Entity &q = geometry[j];
+            if (q.tpe != ET_PLATFORM) {
+                continue;
+            }
+            bool overlap_x = p.anchor.x < q.anchor.x + q.coll_rect.width && q.anchor.x < p.anchor.x + p.coll_rect.width;
+            bool overlap_y = p.anchor.y < q.anchor.y + q.coll_rect.height && q.anchor.y < p.anchor.y + p.coll_rect.height;
+            if (overlap_x && overlap_y) {
+                return false;
+            }
+        }
+    }
+    return true;
 }
 
-CatLevel LoadLevel03(MArena *a, Array<Animation> animations) {
-    CatLevel level = {};
-    level.entities = InitArray<Entity>(a, 64);
-    LoadLevelDefaults(&level, animations);
-    LoadColumnWalls(&level.entities);
+#define LEVEL_DESC(name, trapdoor, portal, geometry) \
+    { name, GetTrapdoorSpawn(trapdoor), trapdoor, portal, geometry, ArrayLen(geometry), NULL, 0, NULL, 0, NULL, 0 }
 
-    level.trapdoor->anchor = GetGridAnchor(0, 0);
-    level.portal->anchor = { 16 * SPRITE_SCALE, 500 };
+#define LEVEL_DESC_MOVERS(name, trapdoor, portal, geometry, movers, keys) \
+    { name, GetTrapdoorSpawn(trapdoor), trapdoor, portal, geometry, ArrayLen(geometry), movers, ArrayLen(movers), keys, ArrayLen(keys), NULL, 0 }
 
-    level.trapdoor->anchor = GetGridAnchor(0, 0);
-    level.portal->anchor = GetGridAnchor(0, 4);
+#define VALIDATE_LEVEL(geometry) \
+    static_assert(ValidateGeometry(geometry, ArrayLen(geometry)), #geometry ": platform overlaps or leaves the column")
 
-    level.entities.Add( InitPlatform( GetGridAnchor(0, 3), grid_w * 2.5 ) );
-    level.entities.Add( InitPlatform( GetGridAnchor(0, 5), grid_w * 2.5 ) );
+constexpr Entity level00_geometry[] = {
+    LEVEL_COLUMN_WALLS,
+    InitPlatform( GetGridAnchor(0, 3), grid_w_max * grid_w ),
+};
+VALIDATE_LEVEL(level00_geometry);
 
-    level.entities.Add( InitPlatform( GetGridAnchor(4.5, 2), grid_w * 2.5 ) );
-    level.entities.Add( InitPlatform( GetGridAnchor(4, 6.5), grid_w * 0.75 ) );
+constexpr Entity level01_geometry[] = {
+    LEVEL_COLUMN_WALLS,
+    InitPlatform( GetGridAnchor(0, 3), grid_w * 2.5 ),
+    InitPlatform( GetGridAnchor(4.5, 3), grid_w * 2.5 ),
+};
+VALIDATE_LEVEL(level01_geometry);
+
+constexpr Entity level02_geometry[] = {
+    LEVEL_COLUMN_WALLS,
+    InitPlatform( GetGridAnchor(0, 3), grid_w * 2.5 ),
+    InitPlatform( GetGridAnchor(4.5, 3), grid_w * 2.5 ),
+    InitPlatform( GetGridAnchor(0, 6), grid_w * 2.5 ),
+    InitPlatform( GetGridAnchor(4.5, 6), grid_w * 2.5 ),
+};
+VALIDATE_LEVEL(level02_geometry);
 
-    return level;
-}
+constexpr Entity level03_geometry[] = {
+    LEVEL_COLUMN_WALLS,
+    InitPlatform( GetGridAnchor(0, 3), grid_w * 2.5 ),
+    InitPlatform( GetGridAnchor(0, 5), grid_w * 2.5 ),
 
-CatLevel LoadLevel04(MArena *a, Array<Animation> animations) {
-    CatLevel level = {};
-    level.entities = InitArray<Entity>(a, 64);
-    LoadLevelDefaults(&level, animations);
-    LoadColumnWalls(&level.entities);
-
-    level.trapdoor->anchor = GetGridAnchor(0, 0);
-    level.portal->anchor = GetGridAnchor(grid_w_max - 1, 2);
-
-    level.entities.Add( InitPlatform( GetGridAnchor(0, 3), grid_w * 1.2 ) );
-    level.entities.Add( InitPlatform( GetGridAnchor(0, 4), grid_w * 1.2 ) );
-    level.entities.Add( InitPlatform( GetGridAnchor(0, 5), grid_w * 1.2 ) );
-    level.entities.Add( InitPlatform( GetGridAnchor(0, 6), grid_w * 1.2 ) );
-    level.entities.Add( InitPlatform( GetGridAnchor(0, 7), grid_w * 1.2 ) );
-    level.entities.Add( InitPlatform( GetGridAnchor(0, 8), grid_w * 1.2 ) );
-    level.entities.Add( InitPlatform( GetGridAnchor(0, 9), grid_w * 1.2 ) );
-
-    level.entities.Add( InitPlatform( GetGridAnchor(grid_w_max - 1.2, 3), grid_w * 1.2 ) );
-    level.entities.Add( InitPlatform( GetGridAnchor(grid_w_max - 1.2, 4), grid_w * 1.2 ) );
-    level.entities.Add( InitPlatform( GetGridAnchor(grid_w_max - 1.2, 5), grid_w * 1.2 ) );
-    level.entities.Add( InitPlatform( GetGridAnchor(grid_w_max - 1.2, 6), grid_w * 1.2 ) );
-    level.entities.Add( InitPlatform( GetGridAnchor(grid_w_max - 1.2, 7), grid_w * 1.2 ) );
-    level.entities.Add( InitPlatform( GetGridAnchor(grid_w_max - 1.2, 8), grid_w * 1.2 ) );
-    level.entities.Add( InitPlatform( GetGridAnchor(grid_w_max - 1.2, 9), grid_w * 1.2 ) );
+    InitPlatform( GetGridAnchor(4.5, 2), grid_w * 2.5 ),
+    InitPlatform( GetGridAnchor(4, 6.5), grid_w * 0.75 ),
+};
+VALIDATE_LEVEL(level03_geometry);
+
+constexpr Entity level04_geometry[] = {
+    LEVEL_COLUMN_WALLS,
+    InitPlatform( GetGridAnchor(0, 3), grid_w * 1.2 ),
+    InitPlatform( GetGridAnchor(0, 4), grid_w * 1.2 ),
+    InitPlatform( GetGridAnchor(0, 5), grid_w * 1.2 ),
+    InitPlatform( GetGridAnchor(0, 6), grid_w * 1.2 ),
+    InitPlatform( GetGridAnchor(0, 7), grid_w * 1.2 ),
+    InitPlatform( GetGridAnchor(0, 8), grid_w * 1.2 ),
+    InitPlatform( GetGridAnchor(0, 9), grid_w * 1.2 ),
+
+    InitPlatform( GetGridAnchor(grid_w_max - 1.2, 3), grid_w * 1.2 ),
+    InitPlatform( GetGridAnchor(grid_w_max - 1.2, 4), grid_w * 1.2 ),
+    InitPlatform( GetGridAnchor(grid_w_max - 1.2, 5), grid_w * 1.2 ),
+    InitPlatform( GetGridAnchor(grid_w_max - 1.2, 6), grid_w * 1.2 ),
+    InitPlatform( GetGridAnchor(grid_w_max - 1.2, 7), grid_w * 1.2 ),
+    InitPlatform( GetGridAnchor(grid_w_max - 1.2, 8), grid_w * 1.2 ),
+    InitPlatform( GetGridAnchor(grid_w_max - 1.2, 9), grid_w * 1.2 ),
+};
+VALIDATE_LEVEL(level04_geometry);
 
-    return level;
-}
+constexpr Entity level05_geometry[] = {
+    LEVEL_COLUMN_WALLS,
+    InitPlatform( GetGridAnchor(0, 3), grid_w * 1 ),
+    InitPlatform( GetGridAnchor(3, 2), grid_w * 1 ),
 
-CatLevel LoadLevel05(MArena *a, Array<Animation> animations) {
-    CatLevel level = {};
-    level.entities = InitArray<Entity>(a, 64);
-    LoadLevelDefaults(&level, animations);
-    LoadColumnWalls(&level.entities);
+    InitPlatform( GetGridAnchor(grid_w_max - 1, 3), grid_w * 1 ),
+};
+VALIDATE_LEVEL(level05_geometry);
 
-    level.trapdoor->anchor = GetGridAnchor(0, 0);
-    level.portal->anchor = GetGridAnchor(grid_w_max - 1, 2);
+constexpr Entity level06_geometry[] = {
+    LEVEL_COLUMN_WALLS,
+    InitPlatform( GetGridAnchor(0, 3), grid_w * 1 ),
+    InitPlatform( GetGridAnchor(4.8, 4), grid_w * 1 ),
 
-    level.entities.Add( InitPlatform( GetGridAnchor(0, 3), grid_w * 1 ) );
-    level.entities.Add( InitPlatform( GetGridAnchor(3, 2), grid_w * 1 ) );
+    InitPlatform( GetGridAnchor(4.8, 3), grid_w * 2.2 ),
+};
+VALIDATE_LEVEL(level06_geometry);
+
+constexpr Entity level07_geometry[] = {
+    LEVEL_COLUMN_WALLS,
+    InitPlatform( GetGridAnchor(0, 7), grid_w * 1 ),
+    InitPlatform( GetGridAnchor(0, 8), grid_w * 2 ),
+
+    InitPlatform( GetGridAnchor(4.8, 8), grid_w * 0.5 ),
+    InitPlatform( GetGridAnchor(6, 7), grid_w * 0.5 ),
+    InitPlatform( GetGridAnchor(4.8, 6), grid_w * 0.5 ),
+    InitPlatform( GetGridAnchor(6, 5), grid_w * 0.5 ),
+
+    InitPlatform( GetGridAnchor(4.8, 4), grid_w * 0.5 ),
+    InitPlatform( GetGridAnchor(6, 3), grid_w * 0.5 ),
+    InitPlatform( GetGridAnchor(4.8, 2), grid_w * 0.5 ),
+    InitPlatform( GetGridAnchor(4.8, 1), grid_w * 2.2 ),
+};
+VALIDATE_LEVEL(level07_geometry);
 
-    level.entities.Add( InitPlatform( GetGridAnchor(grid_w_max - 1, 3), grid_w * 1 ) );
+constexpr Entity level08_geometry[] = {
+    LEVEL_COLUMN_WALLS,
+    InitPlatform( GetGridAnchor(0, 3), grid_w * 1 ),
 
-    return level;
-}
+    InitPlatform( GetGridAnchor(4.8, 6), grid_w * 0.5 ),
+    InitPlatform( GetGridAnchor(6.5, 5), grid_w * 0.5 ),
+    InitPlatform( GetGridAnchor(6.5, 4), grid_w * 0.5 ),
+    InitPlatform( GetGridAnchor(6.5, 3), grid_w * 0.5 ),
 
-CatLevel LoadLevel06(MArena *a, Array<Animation> animations) {
-    CatLevel level = {};
-    level.entities = InitArray<Entity>(a, 64);
-    LoadLevelDefaults(&level, animations);
-    LoadColumnWalls(&level.entities);
+    InitPlatform( GetGridAnchor(4.8, 2), grid_w * 0.5 ),
+    InitPlatform( GetGridAnchor(4.8, 1), grid_w * 2.2 ),
+};
+VALIDATE_LEVEL(level08_geometry);
 
-    level.trapdoor->anchor = GetGridAnchor(0, 0);
-    level.portal->anchor = GetGridAnchor(grid_w_max - 1, 2);
+// a platform swinging across the gap and a lift up to the portal
+constexpr Entity level09_geometry[] = {
+    LEVEL_COLUMN_WALLS,
+    InitPlatform( GetGridAnchor(0, 3), grid_w * 2 ),
+    InitPlatform( GetGridAnchor(6, 1), grid_w * 1 ),
+};
+VALIDATE_LEVEL(level09_geometry);
 
-    level.entities.Add( InitPlatform( GetGridAnchor(0, 3), grid_w * 1 ) );
-    level.entities.Add( InitPlatform( GetGridAnchor(4.8, 4), grid_w * 1 ) );
+constexpr MoverKey level09_keys[] = {
+    { 0, { 0, 0 } },
+    { 1500, { 0, 0 } },
+    { 3000, { 0, - 2 * grid_h } },
+    { 4500, { 0, - 2 * grid_h } },
+};
 
-    level.entities.Add( InitPlatform( GetGridAnchor(4.8, 3), grid_w * 2.2 ) );
+constexpr LevelMover level09_movers[] = {
+    { InitMovingPlatform( GetGridAnchor(2.5, 3), grid_w ), InitSinePath( GetGridAnchor(2.5, 3), { grid_w * 0.5f, 0 }, 3000, 0 ) },
+    { InitMovingPlatform( GetGridAnchor(4.8, 3), grid_w * 0.8f ), InitKeysPath( GetGridAnchor(4.8, 3), 6000, 0, ArrayLen(level09_keys) ) },
+};
 
-    return level;
-}
+constexpr LevelDesc level_descs[] = {
+    LEVEL_DESC( "level00", GetGridAnchor(0, 0), GetGridAnchor(grid_w_max - 1, 2), level00_geometry ),
+    LEVEL_DESC( "level01", GetGridAnchor(0, 0), GetGridAnchor(grid_w_max - 1, 2), level01_geometry ),
+    LEVEL_DESC( "level02", GetGridAnchor(0, 0), GetGridAnchor(grid_w_max - 1, 5), level02_geometry ),
+    LEVEL_DESC( "level03", GetGridAnchor(0, 0), GetGridAnchor(0, 4), level03_geometry ),
+    LEVEL_DESC( "level04", GetGridAnchor(0, 0), GetGridAnchor(grid_w_max - 1, 2), level04_geometry ),
+    LEVEL_DESC( "level05", GetGridAnchor(0, 0), GetGridAnchor(grid_w_max - 1, 2), level05_geometry ),
+    LEVEL_DESC( "level06", GetGridAnchor(0, 0), GetGridAnchor(grid_w_max - 1, 2), level06_geometry ),
+    LEVEL_DESC( "level07", GetGridAnchor(0, 0), GetGridAnchor(grid_w_max - 1, 0), level07_geometry ),
+    LEVEL_DESC( "level08", GetGridAnchor(0, 0), GetGridAnchor(grid_w_max - 1, 0), level08_geometry ),
+    LEVEL_DESC_MOVERS( "level09", GetGridAnchor(0, 0), GetGridAnchor(grid_w_max - 1, 0), level09_geometry, level09_movers, level09_keys ),
+};
 
-CatLevel LoadLevel07(MArena *a, Array<Animation> animations) {
+// the collision grid and trigger rows are built over jobs, which may be NULL
+CatLevel LoadLevel(MArena *a, const LevelDesc *desc, LevelDefaults *defaults, JobSystem *jobs) {
     CatLevel level = {};
-    level.entities = InitArray<Entity>(a, 64);
-    LoadLevelDefaults(&level, animations);
-    LoadColumnWalls(&level.entities);
-
-    level.trapdoor->anchor = GetGridAnchor(0, 0);
-    level.portal->anchor = GetGridAnchor(grid_w_max - 1, 0);
+    level.name = desc->name;
+    level.geometry.arr = desc->geometry;
+    level.geometry.len = desc->geometry_cnt;
+    level.geometry.cap = desc->geometry_cnt;
+    level.spawn = desc->spawn;
+
+    level.top = desc->spawn.y;
+    for (s32 i = 0; i < level.geometry.len; ++i) {
+        const Entity *ent = level.geometry.arr + i;
+        if (ent->tpe == ET_PLATFORM && ent->anchor.y < level.top) {
+            level.top = ent->anchor.y;
+        }
+    }
 
-    level.entities.Add( InitPlatform( GetGridAnchor(0, 7), grid_w * 1 ) );
-    level.entities.Add( InitPlatform( GetGridAnchor(0, 8), grid_w * 2 ) );
+    level.grid = BuildCollGrid(a, level.geometry, jobs);
+    level.entities = InitPool<Entity>(a, 64 + desc->mover_cnt);
+    LoadLevelDefaults(&level, defaults);
 
-    level.entities.Add( InitPlatform( GetGridAnchor(4.8, 8), grid_w * 0.5 ) );
-    level.entities.Add( InitPlatform( GetGridAnchor(6, 7), grid_w * 0.5 ) );
-    level.entities.Add( InitPlatform( GetGridAnchor(4.8, 6), grid_w * 0.5 ) );
-    level.entities.Add( InitPlatform( GetGridAnchor(6, 5), grid_w * 0.5 ) );
+    level.entities.Get(level.portal)->anchor = desc->portal;
 
-    level.entities.Add( InitPlatform( GetGridAnchor(4.8, 4), grid_w * 0.5 ) );
-    level.entities.Add( InitPlatform( GetGridAnchor(6, 3), grid_w * 0.5 ) );
-    level.entities.Add( InitPlatform( GetGridAnchor(4.8, 2), grid_w * 0.5 ) );
-    level.entities.Add( InitPlatform( GetGridAnchor(4.8, 1), grid_w * 2.2 ) );
+    // the trapdoor is the first mover, standing still and opening once
+    level.movers = InitMoverSet(a, desc->mover_cnt + 1, desc->key_cnt);
+    for (s32 i = 0; i < desc->key_cnt; ++i) {
+        level.movers.keys.Add(desc->keys[i]);
+    }
+    Entity *trapdoor = level.entities.Get(level.trapdoor);
+    trapdoor->anchor = desc->trapdoor;
+    trapdoor->mover_idx = level.movers.paths.len;
+    level.movers.paths.Add(InitGatePath(desc->trapdoor, 0, 0, TRAPDOOR_OPEN_MS));
+
+    for (s32 i = 0; i < desc->mover_cnt; ++i) {
+        Entity ent = desc->movers[i].ent;
+        ent.flags |= EF_KINEMATIC;
+        ent.mover_idx = level.movers.paths.len;
+        level.movers.paths.Add(desc->movers[i].path);
+        level.entities.Add(ent); // the activity regions are built below, with it in
+    }
+    UpdateMovers(&level.movers, level.entities.Items(), 0);
+
+    // the portal where it starts, the checkpoints and the kill zone
+    Entity *portal = level.entities.Get(level.portal);
+    portal->Update(0);
+    Array<TriggerVolume> volumes = InitArray<TriggerVolume>(a, desc->checkpoint_cnt + 2);
+    volumes.Add(InitTriggerVolume(TK_PORTAL, portal->coll_rect));
+    for (s32 i = 0; i < desc->checkpoint_cnt; ++i) {
+        Vector2 at = desc->checkpoints[i];
+        Rectangle rect = { at.x - CHECKPOINT_W / 2, at.y - CHECKPOINT_H, CHECKPOINT_W, CHECKPOINT_H };
+        volumes.Add(InitTriggerVolume(TK_CHECKPOINT, rect, at));
+    }
+    volumes.Add(InitKillZone(CAT_FALL_OUT_Y));
+    level.triggers = BuildTriggerSet(a, volumes, jobs);
+    level.activity = BuildActivityRegions(a, &level.movers, &level.entities);
 
     return level;
 }
 
-CatLevel LoadLevel08(MArena *a, Array<Animation> animations) {
-    CatLevel level = {};
-    level.entities = InitArray<Entity>(a, 64);
-    LoadLevelDefaults(&level, animations);
-    LoadColumnWalls(&level.entities);
-
-    level.trapdoor->anchor = GetGridAnchor(0, 0);
-    level.portal->anchor = GetGridAnchor(grid_w_max - 1, 0);
-
-    level.entities.Add( InitPlatform( GetGridAnchor(0, 3), grid_w * 1 ) );
-
-    level.entities.Add( InitPlatform( GetGridAnchor(4.8, 6), grid_w * 0.5 ) );
-    level.entities.Add( InitPlatform( GetGridAnchor(6.5, 5), grid_w * 0.5 ) );
-    level.entities.Add( InitPlatform( GetGridAnchor(6.5, 4), grid_w * 0.5 ) );
-    level.entities.Add( InitPlatform( GetGridAnchor(6.5, 3), grid_w * 0.5 ) );
-
-    level.entities.Add( InitPlatform( GetGridAnchor(4.8, 2), grid_w * 0.5 ) );
-    level.entities.Add( InitPlatform( GetGridAnchor(4.8, 1), grid_w * 2.2 ) );
+struct LevelLoadBatchJob {
+    const LevelDesc *descs;
+    LevelDefaults *defaults;
+    CatLevel *out;
+    MArena *arenas;
+    JobSystem *jobs;
+};
 
+void LevelLoadRange(void *data, s32 lo, s32 hi) {
+    LevelLoadBatchJob *job = (LevelLoadBatchJob*) data;
+    for (s32 i = lo; i < hi; ++i) {
+        job->out[i] = LoadLevel(job->arenas + i, job->descs + i, job->defaults, job->jobs);
+    }
+}
 
-    return level;
+// Loads cnt levels over the job threads, level i into arenas[i], so which thread
+// loads it does not matter.
+void LoadLevelBatch(JobSystem *jobs, const LevelDesc *descs, s32 cnt, LevelDefaults *defaults, CatLevel *out, MArena *arenas) {
+    LevelLoadBatchJob job = { descs, defaults, out, arenas, jobs };
+    ParallelFor(jobs, cnt, 1, LevelLoadRange, &job);
 }
 
 #endif
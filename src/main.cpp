@@ -1,3 +1,5 @@
+#include <cstdlib>
+
 #include "raylib.h"
 
 #include "memory.h"
@@ -5,17 +7,60 @@
 #include "entities.h"
 #include "helpers.h"
 #include "levels.h"
+#include "rollback.h"
+#include "ghosts.h"
+#include "levelgen.h"
+#include "particles.h"
+#include "pacing.h"
+#include "telemetry.h"
+#include "stats.h"
+#include "trace.h"
+#include "dynres.h"
+#include "dbgdraw.h"
 
 
 #define ARENA_CAP 1024*1024 
 u8 mem[ARENA_CAP];
 
+#define RACE_ARENA_CAP 256*1024
+u8 race_mem[RACE_ARENA_CAP];
+
+#define GHOST_ARENA_CAP 16*1024*1024
+#define GHOST_MAX_CNT 2048
+u8 ghost_mem[GHOST_ARENA_CAP];
+
+#define GEN_ARENA_CAP 8*1024*1024
+#define GEN_PLATFORM_CNT 10000
+#define GEN_CHECKPOINT_EVERY 10
+u8 gen_mem[GEN_ARENA_CAP];
+
+#define LEVEL_ARENA_CAP 32*1024 // per built-in level, each loaded into its own
+u8 level_mem[LEVEL_ARENA_CAP * ArrayLen(level_descs)];
+
+#define PARTICLE_ARENA_CAP (PARTICLE_CAP * 32 + 4096)
+u8 particle_mem[PARTICLE_ARENA_CAP];
+
+#define DBG_ARENA_CAP (DBGDRAW_SHAPE_CAP * sizeof(DbgShape) + DBGDRAW_TEXT_CAP * sizeof(DbgText) + 4096)
+u8 dbg_mem[DBG_ARENA_CAP];
+
+
+JobSystem jobs;
+Telemetry telemetry;
+TraceWriter trace;
+
+static_assert((u32) TRACE_COLL_PLATFORM == CC_PLATFORM && (u32) TRACE_COLL_SNAP == CC_SNAP && (u32) TRACE_COLL_WALL == CC_WALL && (u32) TRACE_COLL_PORTAL == CC_PORTAL,
+    "trace readers know the collision flags by value");
+
+// frames this many periods long or longer are logged as spikes
+#define FRAME_SPIKE_FACTOR 1.5f
+
 
 enum GameState {
     GS_TITLESCREEN,
     GS_ENDSCREEN,
     GS_GAME,
     GS_TRANSITION,
+    GS_RACE,
 
     GS_CNT,
 };
@@ -26,12 +71,25 @@ struct CatGame {
     s32 level_next;
     CatLevel *level;
     Array<CatLevel> levels;
+    s32 level_gen; // slot of the generated level, -1 until there is one
     bool dbg_draw;
     Color tint;
 
     f32 transition_elapsed;
     f32 transition_time;
 
+    f32 level_time;
+    TriggerContact contact;
+    TriggerQueue events; // the last CatUpdate's
+    s32 checkpoint; // the last one reached, as a trigger volume, or -1
+    s32 respawns; // at a checkpoint, since entering the level
+    s32 distant_every; // for the levels' activity regions
+    GhostRecorder recorder;
+    GhostSet ghosts;
+    bool ghosts_on;
+
+    ParticlePool particles;
+
     void SetTransition(s32 to_level) {
         if (to_level == levels.len) {
             level_next = -1;
@@ -44,7 +102,11 @@ struct CatGame {
     }
 
     void SetTransitionToNext() {
-        SetTransition(level_at + 1);
+        s32 to = level_at + 1;
+        if (to == level_gen) {
+            to = levels.len;
+        }
+        SetTransition(to);
     }
 
     void SetLevel(s32 to_level) {
@@ -56,25 +118,56 @@ struct CatGame {
 
             level_at = to_level;
             level = levels.arr + level_at;
-
-            level->cat->anchor = GetGridAnchor(0.5f, 1);
-            level->cat->velocity = {};
-
-            Update(0);
+            TelemetryLog(&telemetry, TE_LEVEL_ENTER, level_at);
+
+            Entity *cat = level->entities.Get(level->cat);
+            cat->anchor = level->spawn;
+            cat->velocity = {};
+            cat->accel = {};
+
+            contact = InitTriggerContact();
+            checkpoint = -1;
+            respawns = 0;
+
+            level_time = 0;
+            UpdateMovers(&level->movers, level->entities.Items(), level_time);
+            UpdateEntities(&jobs, level->entities.Items(), 0);
+            level->activity.distant_every = distant_every;
+            ActivityReset(&level->activity, &level->movers, &level->entities, level_time);
+
+            ParticlesClear(&particles);
+            GhostRecorderStart(&recorder, level_at);
+            if (ghosts_on) {
+                GhostSetLoad(&ghosts, level_at, GHOST_MAX_CNT);
+                GhostSetRestart(&ghosts, *cat, cat->anchor);
+            }
+        }
+    }
+    // back to the last checkpoint reached, without leaving the level
+    void Respawn() {
+        assert(checkpoint >= 0);
+        Entity *cat = level->entities.Get(level->cat);
+        cat->anchor = level->triggers.volumes.arr[checkpoint].at;
+        cat->velocity = {};
+        cat->accel = {};
+        cat->Update(0);
+        contact = InitTriggerContact();
+        respawns++;
+    }
+    void ToggleGhosts() {
+        ghosts_on = !ghosts_on;
+        if (ghosts_on) {
+            Entity *cat = level->entities.Get(level->cat);
+            GhostSetLoad(&ghosts, level_at, GHOST_MAX_CNT);
+            GhostSetRestart(&ghosts, *cat, level->spawn);
         }
     }
     void GoToNextLevel() {
         SetLevel(level_at + 1);
     }
+    // after UpdateActivity and level_time moving on by dt
     void Update(f32 dt) {
-        for (s32 i = 0; i < level->entities.len; ++i) {
-            Entity *ent = level->entities.arr + i;
-            if (ent->tpe == ET_UNKNOWN) {
-                continue;
-            }
-
-            ent->Update(dt);
-        }
+        ActivityIntegrate(&level->activity, &jobs, &level->entities, level_time, dt);
     }
 };
 
@@ -83,9 +176,15 @@ CatGame CatGameInit(MArena *a) {
 
     cg.levels = InitArray<CatLevel>(a, 32);
     cg.level_at = 0;
+    cg.level_gen = -1;
     cg.transition_elapsed = 0;
     cg.transition_time = 300;
     cg.tint = WHITE;
+    cg.recorder = GhostRecorderInit(a);
+    cg.ghosts = GhostSetInit(ghost_mem, GHOST_ARENA_CAP);
+
+    MArena particle_arena = ArenaCreate(particle_mem, PARTICLE_ARENA_CAP);
+    cg.particles = InitParticlePool(&particle_arena, PARTICLE_CAP);
 
     return cg;
 }
@@ -93,54 +192,254 @@ CatGame CatGameInit(MArena *a) {
 CatGame game;
 Camera2D cam;
 Array<Animation> animations;
+GhostAtlas ghost_atlas;
+LevelDefaults defaults;
+DynamicResolution dynres;
+DbgDraw dbg;
+MArena gen_arena;
+
+// a fresh level from the time, always in the same slot after the built-in ones
+void PlayGeneratedLevel() {
+    ArenaClear(&gen_arena);
+    LevelGenParams params = { (u64) time(NULL), GEN_PLATFORM_CNT, 0.5f, 0.02f, GEN_CHECKPOINT_EVERY };
+    LevelDesc desc = GenerateLevel(&gen_arena, params);
+    CatLevel level = LoadLevel(&gen_arena, &desc, &defaults, &jobs);
+
+    if (game.level_gen == -1) {
+        game.level_gen = game.levels.len;
+        game.levels.Add(level);
+    }
+    else {
+        game.levels.arr[game.level_gen] = level;
+    }
+    game.SetLevel(game.level_gen);
+}
 
-void DrawGame() {
-    BeginDrawing();
-    BeginMode2D(cam);
-    ClearBackground(BLACK);
+// scrolls up with the cat on levels taller than the screen
+void FollowCat(CatLevel *level) {
+    Entity *cat = level->entities.Get(level->cat);
+    f32 half_h = GetScreenHeight() / cam.zoom / 2;
 
-    Color color = game.tint;
-    for (s32 i = 0; i < game.level->entities.len; ++i) {
-        Entity *ent = game.level->entities.arr + i;
-        if (ent->tpe == ET_UNKNOWN || ent->tpe == ET_CAT) {
+    f32 y = cat->anchor.y - half_h;
+    y = y < level->top - grid_h ? level->top - grid_h : y;
+    y = y > 0 ? 0 : y;
+    cam.target.y = y;
+}
+
+// the part of the level on screen, in entity coordinates; entities are drawn with
+// cam.offset as the origin, so it is added back
+Rectangle GetWorldView() {
+    f32 w = GetScreenWidth() / cam.zoom;
+    f32 h = GetScreenHeight() / cam.zoom;
+    return { cam.target.x - cam.offset.x / cam.zoom + cam.offset.x, cam.target.y - cam.offset.y / cam.zoom + cam.offset.y, w, h };
+}
+
+// wakes what is in view or near the cat, and the ghosts, and brings it up to date;
+// the rest of the level sleeps
+void UpdateActivity() {
+    CatLevel *level = game.level;
+    ActivityRegions *act = &level->activity;
+    Pool<Entity> *entities = &level->entities;
+    Rectangle view = GetWorldView();
+    Rectangle cr = level->entities.Get(level->cat)->coll_rect;
+
+    ActivityBegin(act);
+    ActivityWake(act, entities, view.y, view.y + view.height);
+    ActivityWake(act, entities, cr.y, cr.y + cr.height);
+    if (game.ghosts_on) {
+        for (u32 i = 0; i < game.ghosts.ghosts.len; ++i) {
+            if (game.ghosts.ghosts.arr[i].done == false) {
+                Rectangle gr = game.ghosts.cats.arr[i].coll_rect;
+                ActivityWake(act, entities, gr.y, gr.y + gr.height);
+            }
+        }
+    }
+    ActivityUpdate(act, &level->movers, entities, game.level_time);
+}
+
+// platforms and walls have no sprite, only their edge is drawn
+void DrawGeometry(Array<const Entity> geometry, Color color) {
+    for (s32 i = 0; i < geometry.len; ++i) {
+        const Entity *ent = geometry.arr + i;
+
+        if (ent->tpe == ET_PLATFORM) {
+            Vector2 right = { ent->anchor.x + ent->coll_rect.width, ent->anchor.y };
+            DrawLineEx( Offset(ent->anchor, cam.offset), Offset(right, cam.offset), 2, color);
+            STAT_INC(STAT_DRAW_CALLS);
+        }
+        else if (ent->tpe == ET_WALL_LEFT || ent->tpe == ET_WALL_RIGHT) {
+            Vector2 bottom = { ent->anchor.x, ent->anchor.y + ent->coll_rect.height };
+            DrawLineEx( Offset(ent->anchor, cam.offset), Offset(bottom, cam.offset), 2, color);
+            STAT_INC(STAT_DRAW_CALLS);
+        }
+    }
+}
+
+// a post at every checkpoint, lit once reached
+void DrawCheckpoints(TriggerSet *triggers, s32 reached, Color color) {
+    for (u32 i = 0; i < triggers->volumes.len; ++i) {
+        TriggerVolume *vol = triggers->volumes.arr + i;
+        if (vol->kind != TK_CHECKPOINT) {
             continue;
         }
+        Color c = (s32) i == reached ? Color{ SKYBLUE.r, SKYBLUE.g, SKYBLUE.b, color.a } : color;
+        Vector2 top = { vol->at.x, vol->at.y - CHECKPOINT_H / 2 };
+        DrawLineEx( Offset(vol->at, cam.offset), Offset(top, cam.offset), 4, c);
+        STAT_INC(STAT_DRAW_CALLS);
+    }
+}
 
+void DrawEntities(Array<Entity> entities, Color color) {
+    for (s32 i = 0; i < entities.len; ++i) {
+        Entity *ent = entities.arr + i;
+        if (ent->tpe == ET_UNKNOWN || ent->tpe == ET_CAT || (ent->flags & EF_ASLEEP)) {
+            continue;
+        }
+
+        // an open trapdoor hangs from its hinge
+        Rectangle dst = ent->ani_rect;
+        if (ent->tpe == ET_TRAPDOOR && ent->state == GATE_OPEN) {
+            dst.width /= 8;
+        }
         Frame frame = ent->GetFrame(animations);
-        DrawTexturePro(frame.tex, frame.source, ent->ani_rect, cam.offset, 0.0f, color);
+        DrawTexturePro(frame.tex, frame.source, dst, cam.offset, 0.0f, color);
+        STAT_INC(STAT_DRAW_CALLS);
 
-        if (ent->tpe == ET_PLATFORM) {
+        if (ent->tpe == ET_PLATFORM && ent->state == GATE_CLOSED) {
             Vector2 right = { ent->anchor.x + ent->coll_rect.width, ent->anchor.y };
             DrawLineEx( Offset(ent->anchor, cam.offset), Offset(right, cam.offset), 2, color);
+            STAT_INC(STAT_DRAW_CALLS);
         }
         else if (ent->tpe == ET_WALL_LEFT || ent->tpe == ET_WALL_RIGHT) {
             Vector2 bottom = { ent->anchor.x, ent->anchor.y + ent->coll_rect.height };
             DrawLineEx( Offset(ent->anchor, cam.offset), Offset(bottom, cam.offset), 2, color);
+            STAT_INC(STAT_DRAW_CALLS);
         }
     }
+}
 
-    Frame frame = game.level->cat->GetFrame(animations);
-    DrawTexturePro(frame.tex, frame.source, game.level->cat->ani_rect, cam.offset, 0.0f, color);
+void DrawGame() {
+    BeginDrawing();
+    DynResBeginScene(&dynres);
+    BeginMode2D(DynResCamera(&dynres, cam));
+    ClearBackground(BLACK);
+
+    Color color = game.tint;
+    DrawGeometry(game.level->geometry, color);
+    DrawCheckpoints(&game.level->triggers, game.checkpoint, color);
+    DrawEntities(game.level->entities.Items(), color);
+
+    if (game.ghosts_on) {
+        Color ghost_tint = { color.r, color.g, color.b, (u8) (color.a / 3) };
+        GhostSetDraw(&game.ghosts, &ghost_atlas, cam.offset, ghost_tint);
+        STAT_INC(STAT_DRAW_CALLS);
+    }
+    ParticlesDraw(&game.particles, cam.offset, color.a);
+    STAT_INC(STAT_DRAW_CALLS);
+
+    Entity *cat = game.level->entities.Get(game.level->cat);
+    Frame frame = cat->GetFrame(animations);
+    DrawTexturePro(frame.tex, frame.source, cat->ani_rect, cam.offset, 0.0f, color);
+    STAT_INC(STAT_DRAW_CALLS);
 
     // DBG
     if (IsKeyPressed(KEY_TAB)) {
         game.dbg_draw = !game.dbg_draw;
+        DbgDrawClear(&dbg);
     }
     if (IsKeyPressed(KEY_ENTER)) {
         game.SetTransitionToNext();
     }
-    if (game.dbg_draw) {
+    if (game.dbg_draw && dbg_queue != NULL) {
+        for (s32 i = 0; i < game.level->geometry.len; ++i) {
+            game.level->geometry.arr[i].DrawWireframes_DBG();
+        }
         for (s32 i = 0; i < game.level->entities.len; ++i) {
             Entity *ent = game.level->entities.arr + i;
             if (ent->tpe == ET_UNKNOWN) {
                 continue;
             }
 
-            ent->DrawWireframes_DBG(cam.offset);
+            ent->DrawWireframes_DBG();
         }
+        TriggerSet *triggers = &game.level->triggers;
+        for (u32 i = 0; i < triggers->volumes.len; ++i) {
+            DBG_RECT(TriggerSpanRect(triggers->volumes.arr[i].span), 2, VIOLET);
+        }
+        DBG_RECT(TriggerSpanRect(game.contact.span), 1, VIOLET);
+
+        Rectangle view = GetWorldView();
+        s32 dropped = dbg.dropped.load();
+        DBG_TEXT({ view.x + 10, view.y + 10 }, 20, GRAY, TextFormat("dbg shapes %d, dropped %d", dbg.shape_len.load(), dropped));
+        DbgDrawFlush(&dbg, cam.offset, view);
+        STAT_INC(STAT_DRAW_CALLS);
+    }
+
+    EndMode2D();
+    DynResEndScene(&dynres);
+    EndDrawing();
+}
+
+// local two-player race over a loopback transport, for testing the rollback engine
+
+struct CatRace {
+    MArena arena;
+    LoopbackTransport net;
+    RollbackSession peers[RB_MAX_PLAYERS];
+    f32 elapsed;
+};
+
+CatRace race;
+
+void StartRace(CatLevel *level) {
+    race.arena = ArenaCreate(race_mem, RACE_ARENA_CAP);
+    race.net = LoopbackInit(100, 30, 0.05f, 1);
+    race.elapsed = 0;
+    cam.target = {};
+
+    for (s32 p = 0; p < RB_MAX_PLAYERS; ++p) {
+        race.peers[p] = RollbackInit(&race.arena, level, p, LoopbackGetTransport(&race.net));
+    }
+}
+
+void UpdateRace(f32 dt) {
+    // both peers get the local input; the loopback delays and drops it on the way
+    CatInput input = PollInput();
+
+    race.elapsed += dt;
+    while (race.elapsed >= RB_TICK_MS) {
+        race.elapsed -= RB_TICK_MS;
+        for (s32 p = 0; p < RB_MAX_PLAYERS; ++p) {
+            RollbackAdvance(race.peers + p, input);
+        }
+        LoopbackAdvance(&race.net, RB_TICK_MS);
+        input.jump = false;
+    }
+}
+
+void DrawRace() {
+    RollbackSession *local = race.peers + 0;
+    Color colors[RB_MAX_PLAYERS] = { WHITE, SKYBLUE };
+
+    BeginDrawing();
+    BeginMode2D(cam);
+    ClearBackground(BLACK);
+
+    DrawGeometry(local->sim.geometry, WHITE);
+    DrawEntities(local->sim.entities, WHITE);
+    for (s32 p = RB_MAX_PLAYERS - 1; p >= 0; --p) {
+        Entity *cat = RollbackGetCat(local, p);
+        Frame frame = cat->GetFrame(animations);
+        DrawTexturePro(frame.tex, frame.source, cat->ani_rect, cam.offset, 0.0f, colors[p]);
     }
 
     EndMode2D();
+
+    DrawText(TextFormat("tick %d  rollbacks %d  resim max %d  stalls %d", local->sim.tick, local->rollback_cnt, local->resim_max, local->stall_cnt), 10, 10, 10, GRAY);
+    if (local->desync) {
+        DrawText(TextFormat("DESYNC at tick %d", local->desync_tick), 10, 24, 10, RED);
+    }
+
     EndDrawing();
 }
 
@@ -155,6 +454,7 @@ void OnWindowResize() {
     s32 window_w = GetScreenWidth();
 
     cam.offset = { (window_w - col_width/2) / 2 / cam.zoom, 0 / cam.zoom };
+    DynResResize(&dynres);
 }
 
 int main(void) {
@@ -173,37 +473,116 @@ int main(void) {
         SetWindowSize(def_w, def_h);
     }
 
+#ifdef __EMSCRIPTEN__
     SetTargetFPS(60);
+#else
+    SetTargetFPS(0); // paced below
+#endif
     f32 dt = 0;
     InitInput();
 
     // global state
-    animations = LoadAnimations(&a_life, 64);
+    JobSystemInit(&jobs, JobDefaultThreadCount());
+
+#ifdef CATJUMP_STATS
+    if (StatsInit() == false) {
+        TraceLog(LOG_WARNING, "stats: could not create shared memory %s", STATS_SHM_NAME);
+    }
+#endif
+
+    // set CATJUMP_TELEMETRY to a file to log the session to
+    const char *telemetry_path = getenv("CATJUMP_TELEMETRY");
+    if (telemetry_path != NULL) {
+        if (TelemetryInit(&telemetry, telemetry_path)) {
+            TelemetryLog(&telemetry, TE_SESSION_START, -1);
+        }
+        else {
+            TraceLog(LOG_WARNING, "telemetry: could not open %s", telemetry_path);
+        }
+    }
+
+    // set CATJUMP_TRACE to a file to record every tick of the cat for catjump_trace
+    const char *trace_path = getenv("CATJUMP_TRACE");
+    if (trace_path != NULL && TraceWriterOpen(&trace, trace_path) == false) {
+        TraceLog(LOG_WARNING, "trace: could not open %s", trace_path);
+    }
+    animations = LoadAnimations(&a_life, 64, &jobs);
+
+    ghost_atlas = GhostAtlasLoad();
 
     game = CatGameInit(&a_life);
-    game.levels.Add( LoadLevel00(&a_life, animations) );
-    game.levels.Add( LoadLevel01(&a_life, animations) );
-    game.levels.Add( LoadLevel02(&a_life, animations) );
-    game.levels.Add( LoadLevel03(&a_life, animations) );
-    game.levels.Add( LoadLevel04(&a_life, animations) );
-    game.levels.Add( LoadLevel05(&a_life, animations) );
-    game.levels.Add( LoadLevel06(&a_life, animations) );
-    game.levels.Add( LoadLevel07(&a_life, animations) );
-    game.levels.Add( LoadLevel08(&a_life, animations) );
+    gen_arena = ArenaCreate(gen_mem, GEN_ARENA_CAP);
+    defaults = InitLevelDefaults(animations);
+    MArena level_arenas[ArrayLen(level_descs)];
+    CatLevel levels[ArrayLen(level_descs)];
+    for (u32 i = 0; i < ArrayLen(level_descs); ++i) {
+        level_arenas[i] = ArenaCreate(level_mem + LEVEL_ARENA_CAP * i, LEVEL_ARENA_CAP);
+    }
+    LoadLevelBatch(&jobs, level_descs, ArrayLen(level_descs), &defaults, levels, level_arenas);
+    for (u32 i = 0; i < ArrayLen(level_descs); ++i) {
+        game.levels.Add(levels[i]);
+    }
+
+    // set CATJUMP_DISTANT_EVERY to N for parts of the level out of view to keep
+    // moving, brought up to date every Nth frame
+    const char *distant_every = getenv("CATJUMP_DISTANT_EVERY");
+    if (distant_every != NULL) {
+        game.distant_every = atoi(distant_every);
+    }
 
     game.SetLevel(0);
     game.state = GS_TITLESCREEN;
 
     cam.zoom = 0.5f;
+    dynres = InitDynamicResolution();
+    MArena dbg_arena = ArenaCreate(dbg_mem, DBG_ARENA_CAP);
+    InitDbgDraw(&dbg, &dbg_arena, DBGDRAW_SHAPE_CAP, DBGDRAW_TEXT_CAP);
     OnWindowResize();
 
+    // set CATJUMP_DYNRES to start with dynamic resolution on, [F4] toggles it
+    if (getenv("CATJUMP_DYNRES") != NULL) {
+        DynResToggle(&dynres);
+    }
+
     // DBG
     //game.state = GS_GAME;
     //game.SetLevel(8);
 
     // loop
+    FramePacer pacer = FramePacerInit(60);
     while (!WindowShouldClose()) {
-        dt = GetFrameTime() * 1000;
+        // the last frame's work, from the end of its wait until now
+        DynResUpdate(&dynres, (f32) (PacerNow() - pacer.last), (f32) pacer.period_ms);
+        dt = FramePacerWait(&pacer);
+        dbg_queue = NULL;
+        if (pacer.frame_ms >= pacer.period_ms * FRAME_SPIKE_FACTOR) {
+            TelemetryLog(&telemetry, TE_FRAME_SPIKE, game.level_at, pacer.frame_ms);
+        }
+
+        // what the last frame counted
+        STAT_ARENA(SA_LIFE, &a_life);
+        STAT_ARENA(SA_GEN, &gen_arena);
+        STAT_ARENA(SA_RACE, &race.arena);
+        STAT_ARENA(SA_GHOST, &game.ghosts.arena);
+#ifdef CATJUMP_STATS
+        StatsPublish();
+#endif
+
+        if (IsKeyPressed(KEY_F3)) {
+            FrameHistogram *hist = &pacer.hist;
+            TraceLog(LOG_INFO, "frames %u: mean %.2f ms, p50 %.2f, p99 %.2f, p99.9 %.2f, max %.2f, resyncs %d",
+                hist->cnt, FrameHistogramMean(hist), FrameHistogramPercentile(hist, 0.5f), FrameHistogramPercentile(hist, 0.99f),
+                FrameHistogramPercentile(hist, 0.999f), hist->max_ms, pacer.resyncs);
+            FrameHistogramReset(hist);
+            pacer.resyncs = 0;
+            if (dynres.on) {
+                TraceLog(LOG_INFO, "dynamic resolution: scale %.2f, work %.2f ms", dynres.scale, dynres.work_ms);
+            }
+        }
+
+        if (IsKeyPressed(KEY_F4)) {
+            DynResToggle(&dynres);
+        }
 
         // why is this so verbose?
         if (IsKeyPressed(KEY_F10)) {
@@ -226,6 +605,14 @@ int main(void) {
             if (IsKeyPressed(KEY_SPACE)) {
                 game.state = GS_GAME;
             }
+            if (IsKeyPressed(KEY_R)) {
+                StartRace(game.level);
+                game.state = GS_RACE;
+            }
+            if (IsKeyPressed(KEY_P)) {
+                PlayGeneratedLevel();
+                game.state = GS_GAME;
+            }
 
             BeginDrawing();
 
@@ -233,6 +620,8 @@ int main(void) {
 
             DrawTextCenterX("CAT - QUICK", 36, - 36);
             DrawTextCenterX("Press [space] to jump", 24, 24);
+            DrawTextCenterX("Press [r] for a loopback race, [g] in game for ghosts", 16, 60);
+            DrawTextCenterX("Press [p] for a generated level", 16, 84);
 
             EndDrawing();
         }
@@ -251,6 +640,12 @@ int main(void) {
         }
 
         else if (game.state == GS_GAME) {
+            // debug shapes queue up from here to the end of DrawGame
+            dbg_queue = game.dbg_draw ? &dbg : NULL;
+            if (dbg_queue) {
+                DbgDrawSetView(&dbg, GetWorldView());
+            }
+
             // fade in
             if (game.transition_elapsed < game.transition_time) {
                 game.tint.a = game.transition_elapsed / game.transition_time * 255;
@@ -260,18 +655,60 @@ int main(void) {
                 game.tint.a = 255;
             }
 
+            if (IsKeyPressed(KEY_G)) {
+                game.ToggleGhosts();
+            }
+
+            Entity *cat = game.level->entities.Get(game.level->cat);
+            CatInput input = PollInput();
+            UpdateActivity();
+            game.level_time += dt;
+            GhostRecorderAdd(&game.recorder, dt, input);
+            CatState state_before = (CatState) cat->state;
+            TriggerQueueClear(&game.events);
+            u32 coll = CatUpdate(cat, dt, input, game.level->geometry, game.level->entities.Items(), &game.level->triggers, &game.contact, &game.events, &game.level->grid);
+
             bool cat_exit = false;
             bool cat_fall = false;
-            CatUpdate(game.level->cat, dt, game.level->entities, &cat_fall, &cat_exit);
+            for (s32 i = 0; i < game.events.len; ++i) {
+                TriggerEvent ev = game.events.events[i];
+                if (ev.tpe == TR_ENTER && ev.kind == TK_PORTAL) {
+                    cat_exit = true;
+                }
+                else if (ev.tpe == TR_ENTER && ev.kind == TK_KILL) {
+                    cat_fall = true;
+                }
+                else if (ev.tpe == TR_ENTER && ev.kind == TK_CHECKPOINT) {
+                    game.checkpoint = ev.idx;
+                }
+            }
+            TraceAdd(&trace, { dt, game.level_at, cat->anchor.x, cat->anchor.y, cat->velocity.x, cat->velocity.y, cat->state, cat->frame_idx, coll });
+            EmitCatEffects(&game.particles, cat, state_before, cat_exit);
+            if (state_before != CAT_JUMP && cat->state == CAT_JUMP && cat->velocity.y < 0) {
+                TelemetryLog(&telemetry, TE_JUMP, game.level_at, 0, cat->anchor.x, cat->anchor.y);
+            }
 
             if (cat_exit) {
+                TelemetryLog(&telemetry, TE_LEVEL_EXIT, game.level_at, game.level_time);
+                // a run that came back at a checkpoint does not replay from the spawn
+                if (game.level_at != game.level_gen && game.respawns == 0) {
+                    GhostRecorderSave(&game.recorder, &a_life);
+                }
                 game.SetTransitionToNext();
                 continue;
             }
 
-            if (cat_fall) {
+            if (cat_fall && game.checkpoint >= 0) {
+                TelemetryLog(&telemetry, TE_FALL, game.level_at, game.level_time, cat->anchor.x, cat->anchor.y);
+                game.Respawn();
+            }
+            else if (cat_fall) {
+                TelemetryLog(&telemetry, TE_FALL, game.level_at, game.level_time, cat->anchor.x, cat->anchor.y);
                 s32 to = 0;
-                if (game.level_at > 0) {
+                if (game.level_at == game.level_gen) {
+                    to = game.level_gen;
+                }
+                else if (game.level_at > 0) {
                     to = game.level_at - 1;
                 }
                 game.SetTransition(to);
@@ -279,6 +716,11 @@ int main(void) {
             }
 
             game.Update(dt);
+            ParticlesUpdate(&game.particles, dt);
+            if (game.ghosts_on) {
+                GhostSetUpdate(&game.ghosts, &jobs, game.level_time, game.level->geometry, &game.level->grid, &game.level->triggers, &game.level->movers, game.level->entities.Items(), animations);
+            }
+            FollowCat(game.level);
             DrawGame();
         }
 
@@ -292,15 +734,33 @@ int main(void) {
                 game.transition_elapsed += dt;
                 game.tint.a = (game.transition_time - game.transition_elapsed) / game.transition_time * 255;
             }
+            ParticlesUpdate(&game.particles, dt);
 
-            // NOTE: weirdly, this is required to elapse the time
+            // the fade out
             DrawGame();
         }
 
+        else if (game.state == GS_RACE) {
+            if (IsKeyPressed(KEY_ENTER)) {
+                game.state = GS_TITLESCREEN;
+            }
+
+            UpdateRace(dt);
+            DrawRace();
+        }
+
         // display the frame rate
         //DrawText(TextFormat("FRAME RATE: %0.2f FPS", 1000.0f/dt), 10, 10, 10, DARKGRAY);
     }
 
+    GhostAtlasUnload(&ghost_atlas);
+    DynResRelease(&dynres);
     UnloadTextures(animations);
     CloseWindow();
+    JobSystemShutdown(&jobs);
+    TelemetryShutdown(&telemetry);
+    TraceWriterClose(&trace);
+#ifdef CATJUMP_STATS
+    StatsShutdown();
+#endif
 }
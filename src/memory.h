@@ -2,6 +2,7 @@
 #define __MEMORY_H__
 
 #include <cstdio>
+#include <cstddef>
 #include <cstdint>
 #include <cassert>
 #include <cstring>
@@ -24,6 +25,9 @@ struct MArena {
     u8 *mem;
     u64 cap;
     u64 used;
+#ifdef CATJUMP_STATS
+    u64 high; // the most used has ever been, across clears
+#endif
 };
 
 MArena ArenaCreate(void *mem, u64 capacity = 0) {
@@ -33,11 +37,19 @@ MArena ArenaCreate(void *mem, u64 capacity = 0) {
     return a;
 }
 
+// every allocation starts on this, so any type can be put in one; callers sizing an
+// arena ahead allow up to ARENA_ALIGN - 1 bytes of padding per allocation
+#define ARENA_ALIGN alignof(max_align_t)
+
 void *ArenaAlloc(MArena *a, u64 len, bool zerod = true) {
-    assert(a->cap >= a->used + len && "ArenaAlloc: capaciry exceeded");
+    u64 pad = (u64) (- (uintptr_t) (a->mem + a->used)) & (ARENA_ALIGN - 1);
+    assert(a->cap >= a->used + pad + len && "ArenaAlloc: capaciry exceeded");
 
-    void *result = a->mem + a->used;
-    a->used += len;
+    void *result = a->mem + a->used + pad;
+    a->used += pad + len;
+#ifdef CATJUMP_STATS
+    a->high = a->used > a->high ? a->used : a->high;
+#endif
     memset(result, 0, len);
 
     return result;
@@ -77,6 +89,11 @@ struct Array {
     }
 };
 
+template<typename T, u32 N>
+constexpr u32 ArrayLen(const T (&)[N]) {
+    return N;
+}
+
 template<class T>
 Array<T> InitArray(MArena *a, u32 max_len) {
     Array<T> _arr = {};
@@ -87,4 +104,102 @@ Array<T> InitArray(MArena *a, u32 max_len) {
 }
 
 
+// Pool: fixed capacity, O(1) add and remove, items are kept densely packed in arr so
+// they can be iterated like an Array. Removing swaps the last item into the hole,
+// so pointers into arr are only valid until the next Remove; hold a Handle instead.
+// A handle is a slot index plus the generation of the slot when it was handed out,
+// and stops resolving once the item is removed and the slot reused.
+
+struct Handle {
+    u32 idx;
+    u32 gen; // 0 is never a valid generation, so a zeroed handle is null
+};
+
+#define POOL_FREE_END 0xFFFFFFFF
+
+template<typename T>
+struct Pool {
+    T *arr = NULL;
+    u32 len = 0;
+    u32 cap = 0;
+
+    u32 *dense_to_slot = NULL;
+    u32 *slot_to_dense = NULL; // next free slot while the slot is free
+    u32 *slot_gen = NULL;
+    u32 free_head = POOL_FREE_END;
+
+    Handle Add(T element) {
+        assert(free_head != POOL_FREE_END && "Pool::Add: capacity exceeded");
+
+        u32 slot = free_head;
+        free_head = slot_to_dense[slot];
+
+        u32 dense = len++;
+        arr[dense] = element;
+        dense_to_slot[dense] = slot;
+        slot_to_dense[slot] = dense;
+
+        return Handle { slot, slot_gen[slot] };
+    }
+    bool IsValid(Handle h) {
+        return h.idx < cap && h.gen != 0 && slot_gen[h.idx] == h.gen;
+    }
+    T *Get(Handle h) {
+        if (IsValid(h) == false) {
+            return NULL;
+        }
+        return arr + slot_to_dense[h.idx];
+    }
+    bool Remove(Handle h) {
+        if (IsValid(h) == false) {
+            return false;
+        }
+        u32 dense = slot_to_dense[h.idx];
+        u32 last = --len;
+        if (dense != last) {
+            arr[dense] = arr[last];
+            dense_to_slot[dense] = dense_to_slot[last];
+            slot_to_dense[dense_to_slot[dense]] = dense;
+        }
+
+        slot_gen[h.idx]++;
+        if (slot_gen[h.idx] == 0) {
+            slot_gen[h.idx] = 1;
+        }
+        slot_to_dense[h.idx] = free_head;
+        free_head = h.idx;
+        return true;
+    }
+    Handle HandleAt(u32 dense) {
+        assert(dense < len);
+        u32 slot = dense_to_slot[dense];
+        return Handle { slot, slot_gen[slot] };
+    }
+    Array<T> Items() {
+        Array<T> view = {};
+        view.arr = arr;
+        view.len = len;
+        view.cap = len;
+        return view;
+    }
+};
+
+template<class T>
+Pool<T> InitPool(MArena *a, u32 max_len) {
+    Pool<T> pool = {};
+    pool.cap = max_len;
+    pool.arr = (T*) ArenaAlloc(a, sizeof(T) * max_len);
+    pool.dense_to_slot = (u32*) ArenaAlloc(a, sizeof(u32) * max_len);
+    pool.slot_to_dense = (u32*) ArenaAlloc(a, sizeof(u32) * max_len);
+    pool.slot_gen = (u32*) ArenaAlloc(a, sizeof(u32) * max_len);
+
+    for (u32 i = 0; i < max_len; ++i) {
+        pool.slot_to_dense[i] = (i + 1 < max_len) ? i + 1 : POOL_FREE_END;
+        pool.slot_gen[i] = 1;
+    }
+    pool.free_head = max_len ? 0 : POOL_FREE_END;
+    return pool;
+}
+
+
 #endif
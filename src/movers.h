@@ -0,0 +1,265 @@
+#ifndef __MOVERS_H__
+#define __MOVERS_H__
+
+
+#include <cmath>
+
+#include "raylib.h"
+#include "memory.h"
+#include "entities.h"
+
+
+// Kinematic movers.
+//
+// A mover is an entity whose position is a function of level time: a sine around its
+// origin, or a looping path through keyframes. Nothing is integrated, so a mover is
+// exactly where its path says at any tick, however the ticks were stepped, and
+// rollback or replay gets the same positions for free. Hazards like trapdoors also
+// open and close on a schedule evaluated the same way.
+//
+// Every path is evaluated in one pass over the level's paths, then the results are
+// copied onto the entities flagged EF_KINEMATIC, which find theirs through mover_idx.
+
+
+enum MoverPathType {
+    MP_FIXED,
+    MP_SINE,
+    MP_KEYS,
+};
+
+struct MoverKey {
+    f32 t; // ms into the cycle, increasing, first key at 0
+    Vector2 offset; // from the path origin
+};
+
+struct MoverPath {
+    MoverPathType tpe;
+    Vector2 origin;
+    Vector2 amplitude; // MP_SINE
+    f32 period; // ms per cycle, MP_SINE and MP_KEYS
+    f32 phase; // fraction of a cycle
+    s32 key_first; // MP_KEYS, into the set's keys
+    s32 key_cnt;
+
+    // open during [open_from, open_to) of every gate_period ms; a gate_period of 0
+    // opens once, counting from the start of the level
+    bool gated;
+    f32 gate_period;
+    f32 open_from;
+    f32 open_to;
+};
+
+// a mover entity and its path, as they appear in a level description
+struct LevelMover {
+    Entity ent;
+    MoverPath path;
+};
+
+struct MoverSet {
+    Array<MoverPath> paths;
+    Array<MoverKey> keys;
+
+    // the last evaluation, one per path
+    Vector2 *pos;
+    Vector2 *vel;
+    u8 *open;
+};
+
+MoverSet InitMoverSet(MArena *a, s32 path_cap, s32 key_cap) {
+    MoverSet set = {};
+    set.paths = InitArray<MoverPath>(a, path_cap);
+    set.keys = InitArray<MoverKey>(a, key_cap);
+    set.pos = (Vector2*) ArenaAlloc(a, sizeof(Vector2) * path_cap);
+    set.vel = (Vector2*) ArenaAlloc(a, sizeof(Vector2) * path_cap);
+    set.open = (u8*) ArenaAlloc(a, sizeof(u8) * path_cap);
+    return set;
+}
+
+constexpr MoverPath InitSinePath(Vector2 origin, Vector2 amplitude, f32 period, f32 phase) {
+    MoverPath path = {};
+    path.tpe = MP_SINE;
+    path.origin = origin;
+    path.amplitude = amplitude;
+    path.period = period;
+    path.phase = phase;
+    return path;
+}
+
+// keys are key_first .. key_first + key_cnt of the set's keys
+constexpr MoverPath InitKeysPath(Vector2 origin, f32 period, s32 key_first, s32 key_cnt) {
+    MoverPath path = {};
+    path.tpe = MP_KEYS;
+    path.origin = origin;
+    path.period = period;
+    path.key_first = key_first;
+    path.key_cnt = key_cnt;
+    return path;
+}
+
+constexpr MoverPath InitGatePath(Vector2 origin, f32 gate_period, f32 open_from, f32 open_to) {
+    MoverPath path = {};
+    path.tpe = MP_FIXED;
+    path.origin = origin;
+    path.gated = true;
+    path.gate_period = gate_period;
+    path.open_from = open_from;
+    path.open_to = open_to;
+    return path;
+}
+
+// moving platforms are deeper than static ones, the sine between two evaluations is
+// not quite the straight line a riding cat follows
+#define MOVER_PLATFORM_DEPTH 8
+
+constexpr Entity InitMovingPlatform(Vector2 position, f32 width) {
+    Entity platform = InitPlatform(position, width);
+    platform.coll_rect.height = MOVER_PLATFORM_DEPTH;
+    platform.flags = EF_KINEMATIC;
+    return platform;
+}
+
+// evaluation
+
+// fraction of the way through a cycle; reduced in double so long levels keep precision
+f32 MoverCycle(f64 time, f32 period, f32 phase) {
+    f64 c = time / period + phase;
+    return (f32) (c - floor(c));
+}
+
+f64 MoverTimeFromTick(s64 tick) {
+    return tick * (f64) CAT_TICK_MS;
+}
+
+void MoverEvalKeys(MoverSet *set, MoverPath *path, f32 cycle, Vector2 *pos, Vector2 *vel) {
+    MoverKey *keys = set->keys.arr + path->key_first;
+    f32 t = cycle * path->period;
+
+    // the segment from the last key wraps to the first
+    s32 i = 0;
+    while (i + 1 < path->key_cnt && keys[i + 1].t <= t) {
+        ++i;
+    }
+    MoverKey k0 = keys[i];
+    MoverKey k1 = (i + 1 < path->key_cnt) ? keys[i + 1] : MoverKey { path->period, keys[0].offset };
+
+    // eased in and out, so a mover never pulls away from a riding cat faster than
+    // gravity can keep up with
+    f32 span = k1.t - k0.t;
+    f32 u = (t - k0.t) / span;
+    f32 e = u * u * (3 - 2 * u);
+    f32 de = 6 * u * (1 - u) / span;
+    Vector2 d = { k1.offset.x - k0.offset.x, k1.offset.y - k0.offset.y };
+    *pos = { path->origin.x + k0.offset.x + e * d.x, path->origin.y + k0.offset.y + e * d.y };
+    *vel = { de * d.x, de * d.y };
+}
+
+// where path i has its entity at time, leaving the set's last evaluation alone
+void MoverPose(MoverSet *set, s32 i, f64 time, Vector2 *out_pos, Vector2 *out_vel, u8 *out_open) {
+    MoverPath *path = set->paths.arr + i;
+    Vector2 pos = path->origin;
+    Vector2 vel = {};
+
+    if (path->tpe == MP_SINE) {
+        f32 w = 2 * PI / path->period;
+        f32 a = 2 * PI * MoverCycle(time, path->period, path->phase);
+        f32 s = sinf(a);
+        f32 c = cosf(a);
+        pos = { path->origin.x + path->amplitude.x * s, path->origin.y + path->amplitude.y * s };
+        vel = { path->amplitude.x * w * c, path->amplitude.y * w * c };
+    }
+    else if (path->tpe == MP_KEYS) {
+        MoverEvalKeys(set, path, MoverCycle(time, path->period, path->phase), &pos, &vel);
+    }
+
+    u8 open = 0;
+    if (path->gated) {
+        f32 t = (path->gate_period > 0) ? MoverCycle(time, path->gate_period, 0) * path->gate_period : (f32) time;
+        open = t >= path->open_from && t < path->open_to;
+    }
+
+    *out_pos = pos;
+    *out_vel = vel;
+    *out_open = open;
+}
+
+void MoverEvalPath(MoverSet *set, s32 i, f64 time) {
+    MoverPose(set, i, time, set->pos + i, set->vel + i, set->open + i);
+}
+
+void MoverSetEvaluate(MoverSet *set, f64 time) {
+    for (s32 i = 0; i < set->paths.len; ++i) {
+        MoverEvalPath(set, i, time);
+    }
+}
+
+// puts a kinematic entity where the last evaluation of its path says
+void MoverApply(MoverSet *set, Entity *ent) {
+    assert(ent->mover_idx >= 0 && ent->mover_idx < set->paths.len);
+
+    ent->anchor = set->pos[ent->mover_idx];
+    ent->velocity = set->vel[ent->mover_idx];
+    ent->accel = {};
+    ent->state = set->open[ent->mover_idx];
+    ent->Update(0);
+}
+
+// a copy of a kinematic entity where its path has it at time, for whatever runs on
+// its own clock, like ghosts
+Entity MoverPosedAt(MoverSet *set, const Entity *ent, f64 time) {
+    assert(ent->mover_idx >= 0 && ent->mover_idx < set->paths.len);
+
+    Entity posed = *ent;
+    u8 open = 0;
+    MoverPose(set, ent->mover_idx, time, &posed.anchor, &posed.velocity, &open);
+    posed.accel = {};
+    posed.state = open;
+    posed.flags &= ~EF_ASLEEP;
+    posed.Update(0);
+    return posed;
+}
+
+void MoverSetApply(MoverSet *set, Array<Entity> entities) {
+    for (s32 i = 0; i < entities.len; ++i) {
+        Entity *ent = entities.arr + i;
+        if (ent->flags & EF_KINEMATIC) {
+            MoverApply(set, ent);
+        }
+    }
+}
+
+// what a path can cover, for the entity's anchor
+void MoverPathBounds(MoverSet *set, s32 i, Vector2 *lo, Vector2 *hi) {
+    MoverPath *path = set->paths.arr + i;
+    *lo = path->origin;
+    *hi = path->origin;
+    if (path->tpe == MP_SINE) {
+        *lo = { path->origin.x - fabsf(path->amplitude.x), path->origin.y - fabsf(path->amplitude.y) };
+        *hi = { path->origin.x + fabsf(path->amplitude.x), path->origin.y + fabsf(path->amplitude.y) };
+    }
+    else if (path->tpe == MP_KEYS) {
+        // eased between keys, never past them
+        for (s32 k = 0; k < path->key_cnt; ++k) {
+            Vector2 p = { path->origin.x + set->keys.arr[path->key_first + k].offset.x, path->origin.y + set->keys.arr[path->key_first + k].offset.y };
+            lo->x = p.x < lo->x ? p.x : lo->x;
+            lo->y = p.y < lo->y ? p.y : lo->y;
+            hi->x = p.x > hi->x ? p.x : hi->x;
+            hi->y = p.y > hi->y ? p.y : hi->y;
+        }
+    }
+}
+
+// the area a kinematic entity's collision rect can be in, grown by margin
+Rectangle MoverPathRect(MoverSet *set, const Entity *ent, f32 margin) {
+    Vector2 lo, hi;
+    MoverPathBounds(set, ent->mover_idx, &lo, &hi);
+    f32 m = margin;
+    return { lo.x + ent->coll_offset.x - m, lo.y + ent->coll_offset.y - m, hi.x - lo.x + ent->coll_rect.width + 2 * m, hi.y - lo.y + ent->coll_rect.height + 2 * m };
+}
+
+void UpdateMovers(MoverSet *set, Array<Entity> entities, f64 time) {
+    MoverSetEvaluate(set, time);
+    MoverSetApply(set, entities);
+}
+
+
+#endif
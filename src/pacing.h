@@ -0,0 +1,161 @@
+#ifndef __PACING_H__
+#define __PACING_H__
+
+
+#include <chrono>
+#ifndef __EMSCRIPTEN__
+#include <thread>
+#endif
+
+#include "memory.h"
+
+
+// Frame pacing.
+//
+// Each frame waits for its deadline on the monotonic clock: it sleeps while the
+// deadline is further away than the sleep overshoot we have seen lately, then spins
+// for the rest. Deadlines advance by exactly one period, so a late frame is made up
+// for by the next one, unless we fell a whole period behind (descheduled, dragging the
+// window) in which case the schedule restarts from now instead of rushing frames.
+//
+// The browser paces the web build, there the pacer only measures.
+
+
+#define PACER_HIST_BIN_MS 0.25f
+#define PACER_HIST_BINS 200 // up to 50 ms, slower frames go into the last bin
+#define PACER_SMOOTH_CNT 4
+#define PACER_MAX_DT 100.0f
+#define PACER_SNAP 0.05f
+
+f64 PacerNow() {
+    return std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+// histogram
+
+struct FrameHistogram {
+    u32 bins[PACER_HIST_BINS + 1];
+    u32 cnt;
+    f32 max_ms;
+    f64 sum_ms;
+};
+
+void FrameHistogramAdd(FrameHistogram *hist, f32 ms) {
+    s32 bin = (s32) (ms / PACER_HIST_BIN_MS);
+    bin = bin < 0 ? 0 : (bin > PACER_HIST_BINS ? PACER_HIST_BINS : bin);
+    hist->bins[bin]++;
+    hist->cnt++;
+    hist->sum_ms += ms;
+    hist->max_ms = ms > hist->max_ms ? ms : hist->max_ms;
+}
+
+// frame time in ms that a fraction p of the frames came in under, to bin precision
+f32 FrameHistogramPercentile(FrameHistogram *hist, f32 p) {
+    if (hist->cnt == 0) {
+        return 0;
+    }
+    u32 rank = (u32) (p * hist->cnt);
+    rank = rank >= hist->cnt ? hist->cnt - 1 : rank;
+
+    u32 seen = 0;
+    for (s32 i = 0; i < PACER_HIST_BINS; ++i) {
+        seen += hist->bins[i];
+        if (seen > rank) {
+            return (i + 1) * PACER_HIST_BIN_MS;
+        }
+    }
+    return hist->max_ms;
+}
+
+f32 FrameHistogramMean(FrameHistogram *hist) {
+    return hist->cnt ? (f32) (hist->sum_ms / hist->cnt) : 0;
+}
+
+void FrameHistogramReset(FrameHistogram *hist) {
+    *hist = {};
+}
+
+
+// pacer
+
+struct FramePacer {
+    f64 period_ms;
+    f64 deadline;
+    f64 last;
+    f64 spin_ms; // how early to stop sleeping, follows the worst recent overshoot
+    s32 resyncs;
+    f32 frame_ms; // the last frame, unsmoothed
+
+    f32 raw[PACER_SMOOTH_CNT];
+    s32 raw_at;
+
+    FrameHistogram hist;
+};
+
+FramePacer FramePacerInit(f32 fps) {
+    FramePacer pacer = {};
+    pacer.period_ms = 1000.0 / fps;
+    pacer.last = PacerNow();
+    pacer.deadline = pacer.last + pacer.period_ms;
+    pacer.spin_ms = 2;
+    for (s32 i = 0; i < PACER_SMOOTH_CNT; ++i) {
+        pacer.raw[i] = (f32) pacer.period_ms;
+    }
+    return pacer;
+}
+
+void FramePacerSleepUntil(FramePacer *pacer, f64 deadline) {
+#ifndef __EMSCRIPTEN__
+    f64 now = PacerNow();
+    if (deadline - now > pacer->spin_ms) {
+        f64 wake = deadline - pacer->spin_ms;
+        std::this_thread::sleep_for(std::chrono::duration<f64, std::milli>(wake - now));
+
+        f64 overshoot = PacerNow() - wake;
+        f64 decayed = pacer->spin_ms * 0.99;
+        f64 wanted = overshoot * 1.25;
+        pacer->spin_ms = wanted > decayed ? wanted : decayed;
+        pacer->spin_ms = pacer->spin_ms < 0.5 ? 0.5 : (pacer->spin_ms > 4 ? 4 : pacer->spin_ms);
+    }
+    while (PacerNow() < deadline) {
+    }
+#endif
+}
+
+// waits out the frame and returns the dt to simulate it with, in ms
+f32 FramePacerWait(FramePacer *pacer) {
+    FramePacerSleepUntil(pacer, pacer->deadline);
+
+    f64 now = PacerNow();
+    f32 frame_ms = (f32) (now - pacer->last);
+    pacer->last = now;
+    pacer->frame_ms = frame_ms;
+    FrameHistogramAdd(&pacer->hist, frame_ms);
+
+    pacer->deadline += pacer->period_ms;
+    if (now > pacer->deadline) {
+        pacer->deadline = now + pacer->period_ms;
+        pacer->resyncs++;
+    }
+
+    // average the last few frames and snap to the period when close, so scheduler
+    // noise does not reach the simulation
+    pacer->raw[pacer->raw_at] = frame_ms > PACER_MAX_DT ? PACER_MAX_DT : frame_ms;
+    pacer->raw_at = (pacer->raw_at + 1) % PACER_SMOOTH_CNT;
+
+    f32 dt = 0;
+    for (s32 i = 0; i < PACER_SMOOTH_CNT; ++i) {
+        dt += pacer->raw[i];
+    }
+    dt /= PACER_SMOOTH_CNT;
+
+    f32 period = (f32) pacer->period_ms;
+    if (dt > period * (1 - PACER_SNAP) && dt < period * (1 + PACER_SNAP)) {
+        dt = period;
+    }
+    return dt;
+}
+
+
+#endif
@@ -0,0 +1,245 @@
+#ifndef __PARTICLES_H__
+#define __PARTICLES_H__
+
+
+#include <cmath>
+
+#include "raylib.h"
+#include "rlgl.h"
+#include "memory.h"
+#include "entities.h"
+
+
+// Particles.
+//
+// A fixed-capacity pool kept as a structure of arrays, so the per-frame update is a
+// straight loop over packed floats that the compiler vectorizes. Live particles are
+// always the first len slots: culling swap-removes and emitting appends, so nothing
+// is ever allocated after init.
+
+
+#define PARTICLE_CAP (128 * 1024)
+#define PARTICLE_GRAVITY (0.5f * CAT_GRAVITY)
+
+struct ParticlePool {
+    f32 *x;
+    f32 *y;
+    f32 *vx;
+    f32 *vy;
+    f32 *life; // ms left
+    f32 *inv_life; // 1 / initial life, for the fade
+    f32 *size;
+    Color *color;
+    s32 len;
+    s32 cap;
+    u32 rng;
+};
+
+ParticlePool InitParticlePool(MArena *a, s32 cap) {
+    ParticlePool pool = {};
+    pool.x = (f32*) ArenaAlloc(a, sizeof(f32) * cap);
+    pool.y = (f32*) ArenaAlloc(a, sizeof(f32) * cap);
+    pool.vx = (f32*) ArenaAlloc(a, sizeof(f32) * cap);
+    pool.vy = (f32*) ArenaAlloc(a, sizeof(f32) * cap);
+    pool.life = (f32*) ArenaAlloc(a, sizeof(f32) * cap);
+    pool.inv_life = (f32*) ArenaAlloc(a, sizeof(f32) * cap);
+    pool.size = (f32*) ArenaAlloc(a, sizeof(f32) * cap);
+    pool.color = (Color*) ArenaAlloc(a, sizeof(Color) * cap);
+    pool.cap = cap;
+    pool.rng = 0x2545F491;
+    return pool;
+}
+
+void ParticlesClear(ParticlePool *pool) {
+    pool->len = 0;
+}
+
+
+// emitting
+
+struct ParticleBurst {
+    Vector2 pos;
+    Vector2 extent; // particles start anywhere in pos + [0, extent]
+    s32 cnt;
+    f32 angle; // direction of the burst, radians, 0 is right and y points down
+    f32 spread; // half-angle around it
+    f32 speed_lo;
+    f32 speed_hi;
+    f32 life_lo;
+    f32 life_hi;
+    f32 size;
+    Color color;
+};
+
+f32 ParticleRandom(ParticlePool *pool) {
+    u32 x = pool->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    pool->rng = x;
+    return (x >> 8) * (1.0f / (1 << 24));
+}
+
+// bursts are cut short when the pool is full
+void ParticlesEmit(ParticlePool *pool, ParticleBurst burst) {
+    s32 cnt = burst.cnt;
+    if (cnt > pool->cap - pool->len) {
+        cnt = pool->cap - pool->len;
+    }
+
+    for (s32 i = pool->len; i < pool->len + cnt; ++i) {
+        f32 a = burst.angle + burst.spread * (2 * ParticleRandom(pool) - 1);
+        f32 speed = burst.speed_lo + (burst.speed_hi - burst.speed_lo) * ParticleRandom(pool);
+        f32 life = burst.life_lo + (burst.life_hi - burst.life_lo) * ParticleRandom(pool);
+
+        pool->x[i] = burst.pos.x + burst.extent.x * ParticleRandom(pool);
+        pool->y[i] = burst.pos.y + burst.extent.y * ParticleRandom(pool);
+        pool->vx[i] = speed * cosf(a);
+        pool->vy[i] = speed * sinf(a);
+        pool->life[i] = life;
+        pool->inv_life[i] = 1.0f / life;
+        pool->size[i] = burst.size;
+        pool->color[i] = burst.color;
+    }
+    pool->len += cnt;
+}
+
+
+// update
+
+// integrate, then cull; dead particles are rare in any one frame, so they are
+// swap-removed with the last live one instead of compacting all the arrays
+void ParticlesUpdate(ParticlePool *pool, f32 dt) {
+    s32 n = pool->len;
+    f32 *__restrict x = pool->x;
+    f32 *__restrict y = pool->y;
+    f32 *__restrict vx = pool->vx;
+    f32 *__restrict vy = pool->vy;
+    f32 *__restrict life = pool->life;
+
+    f32 g = PARTICLE_GRAVITY;
+    f32 half_g_dt2 = 0.5f * g * dt * dt;
+    for (s32 i = 0; i < n; ++i) {
+        x[i] += vx[i] * dt;
+        y[i] += vy[i] * dt + half_g_dt2;
+        vy[i] += g * dt;
+        life[i] -= dt;
+    }
+
+    s32 i = 0;
+    while (i < n) {
+        if (life[i] > 0) {
+            ++i;
+            continue;
+        }
+        --n;
+        x[i] = x[n];
+        y[i] = y[n];
+        vx[i] = vx[n];
+        vy[i] = vy[n];
+        life[i] = life[n];
+        pool->inv_life[i] = pool->inv_life[n];
+        pool->size[i] = pool->size[n];
+        pool->color[i] = pool->color[n];
+    }
+    pool->len = n;
+}
+
+
+// drawing
+
+// all particles as untextured quads in one batch; origin is subtracted like in DrawTexturePro
+void ParticlesDraw(ParticlePool *pool, Vector2 origin, u8 alpha) {
+    if (pool->len == 0) {
+        return;
+    }
+
+    rlSetTexture(0);
+    rlBegin(RL_QUADS);
+    rlNormal3f(0.0f, 0.0f, 1.0f);
+
+    for (s32 i = 0; i < pool->len; ++i) {
+        rlCheckRenderBatchLimit(4);
+
+        Color c = pool->color[i];
+        f32 fade = pool->life[i] * pool->inv_life[i];
+        rlColor4ub(c.r, c.g, c.b, (u8) (c.a * fade * alpha / 255));
+
+        f32 h = 0.5f * pool->size[i];
+        f32 x0 = pool->x[i] - h - origin.x;
+        f32 y0 = pool->y[i] - h - origin.y;
+        f32 x1 = x0 + 2 * h;
+        f32 y1 = y0 + 2 * h;
+
+        rlVertex2f(x0, y0);
+        rlVertex2f(x0, y1);
+        rlVertex2f(x1, y1);
+        rlVertex2f(x1, y0);
+    }
+
+    rlEnd();
+}
+
+
+// cat effects
+
+// bursts for the cat's state changes this frame; state_before is its state going into CatUpdate
+void EmitCatEffects(ParticlePool *pool, const Entity *cat, CatState state_before, bool exited) {
+    Rectangle cr = cat->coll_rect;
+    Vector2 feet = { cr.x, cr.y + cr.height };
+
+    bool was_grounded = state_before == CAT_IDLE || state_before == CAT_RUN;
+    bool was_airborne = state_before == CAT_JUMP || state_before == CAT_FALL;
+    bool is_grounded = cat->state == CAT_IDLE || cat->state == CAT_RUN;
+
+    // a jump leaves the ground moving up; walking off a ledge does not
+    if (was_grounded && cat->state == CAT_JUMP && cat->velocity.y < 0) {
+        ParticleBurst burst = {};
+        burst.pos = feet;
+        burst.extent = { cr.width, 0 };
+        burst.cnt = 24;
+        burst.angle = - PI / 2;
+        burst.spread = PI / 2;
+        burst.speed_lo = 0.05f;
+        burst.speed_hi = 0.2f;
+        burst.life_lo = 150;
+        burst.life_hi = 350;
+        burst.size = 6;
+        burst.color = LIGHTGRAY;
+        ParticlesEmit(pool, burst);
+    }
+
+    if (was_airborne && is_grounded) {
+        ParticleBurst burst = {};
+        burst.pos = feet;
+        burst.extent = { cr.width, 0 };
+        burst.cnt = 48;
+        burst.angle = - PI / 2;
+        burst.spread = PI / 2.5f;
+        burst.speed_lo = 0.1f;
+        burst.speed_hi = 0.4f;
+        burst.life_lo = 200;
+        burst.life_hi = 450;
+        burst.size = 6;
+        burst.color = GRAY;
+        ParticlesEmit(pool, burst);
+    }
+
+    if (exited) {
+        ParticleBurst burst = {};
+        burst.pos = { cr.x + cr.width / 2, cr.y + cr.height / 2 };
+        burst.cnt = 256;
+        burst.angle = 0;
+        burst.spread = PI;
+        burst.speed_lo = 0.1f;
+        burst.speed_hi = 0.6f;
+        burst.life_lo = 300;
+        burst.life_hi = 800;
+        burst.size = 8;
+        burst.color = VIOLET;
+        ParticlesEmit(pool, burst);
+    }
+}
+
+
+#endif
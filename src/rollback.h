@@ -0,0 +1,475 @@
+#ifndef __ROLLBACK_H__
+#define __ROLLBACK_H__
+
+
+#include "memory.h"
+#include "input.h"
+#include "entities.h"
+#include "levels.h"
+
+
+// Rollback netcode for two-player races.
+//
+// Both peers run the same deterministic simulation at a fixed tick. Remote inputs that
+// have not arrived yet are predicted; when the real input arrives and differs from the
+// prediction, the simulation is restored to the snapshot taken before that tick and
+// re-run up to the present within the same frame. Each peer also sends the checksum
+// of its latest fully confirmed tick, so a desync is detected instead of drifting.
+
+
+#define RB_MAX_PLAYERS 2
+#define RB_HISTORY 32 // ticks of snapshots and inputs kept, power of two
+#define RB_MAX_ROLLBACK_DEFAULT 10
+#define RB_TICK_MS CAT_TICK_MS
+
+
+// race simulation
+
+struct RaceSim {
+    Vector2 spawn;
+    Array<const Entity> geometry;
+    CollGrid *grid;
+    TriggerSet *triggers;
+    MoverSet *movers;
+    Array<Entity> entities;
+    s32 cat_idx[RB_MAX_PLAYERS];
+    TriggerContact contacts[RB_MAX_PLAYERS];
+    Vector2 respawn[RB_MAX_PLAYERS]; // the spawn or the last checkpoint reached
+    s32 player_cnt;
+    s32 tick;
+    s32 finish_tick[RB_MAX_PLAYERS]; // -1 while racing
+    s32 fall_cnt[RB_MAX_PLAYERS];
+};
+
+RaceSim RaceSimInit(MArena *a, CatLevel *level, s32 player_cnt) {
+    assert(player_cnt > 0 && player_cnt <= RB_MAX_PLAYERS);
+
+    RaceSim sim = {};
+    sim.player_cnt = player_cnt;
+    sim.geometry = level->geometry;
+    sim.grid = &level->grid;
+    sim.triggers = &level->triggers;
+    sim.movers = &level->movers;
+    sim.spawn = level->spawn;
+    sim.entities = InitArray<Entity>(a, level->entities.len + player_cnt);
+
+    for (s32 i = 0; i < (s32) level->entities.len; ++i) {
+        // the race updates everything, every tick
+        if (level->entities.arr[i].tpe != ET_CAT) {
+            sim.entities.Add(level->entities.arr[i])->flags &= ~EF_ASLEEP;
+        }
+    }
+    for (s32 p = 0; p < player_cnt; ++p) {
+        sim.cat_idx[p] = sim.entities.len;
+        Entity *cat = sim.entities.Add(*level->entities.Get(level->cat));
+        cat->anchor = sim.spawn;
+        cat->velocity = {};
+        sim.finish_tick[p] = -1;
+        sim.contacts[p] = InitTriggerContact();
+        sim.respawn[p] = sim.spawn;
+    }
+    for (s32 i = 0; i < (s32) sim.entities.len; ++i) {
+        sim.entities.arr[i].Update(0);
+    }
+    return sim;
+}
+
+void RaceSimStep(RaceSim *sim, CatInput *inputs, f32 dt) {
+    UpdateMovers(sim->movers, sim->entities, MoverTimeFromTick(sim->tick));
+
+    for (s32 p = 0; p < sim->player_cnt; ++p) {
+        if (sim->finish_tick[p] >= 0) {
+            continue;
+        }
+        Entity *cat = sim->entities.arr + sim->cat_idx[p];
+
+        TriggerQueue events = {};
+        CatUpdate(cat, dt, inputs[p], sim->geometry, sim->entities, sim->triggers, sim->contacts + p, &events, sim->grid);
+
+        for (s32 i = 0; i < events.len; ++i) {
+            TriggerEvent ev = events.events[i];
+            if (ev.tpe != TR_ENTER) {
+                continue;
+            }
+            if (ev.kind == TK_PORTAL) {
+                sim->finish_tick[p] = sim->tick;
+                cat->velocity = {};
+            }
+            else if (ev.kind == TK_KILL) {
+                sim->fall_cnt[p]++;
+                cat->anchor = sim->respawn[p];
+                cat->velocity = {};
+                cat->accel = {};
+                sim->contacts[p] = InitTriggerContact();
+            }
+            else if (ev.kind == TK_CHECKPOINT) {
+                sim->respawn[p] = sim->triggers->volumes.arr[ev.idx].at;
+            }
+        }
+    }
+
+    UpdateEntities(NULL, sim->entities, dt);
+    sim->tick++;
+}
+
+u32 HashBytes(u32 hash, void *data, u32 len) {
+    u8 *bytes = (u8*) data;
+    for (u32 i = 0; i < len; ++i) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// only the simulated fields are hashed; frame_idx is advanced while drawing and
+// may legitimately differ between peers
+u32 RaceSimChecksum(RaceSim *sim) {
+    u32 hash = 2166136261u;
+    hash = HashBytes(hash, &sim->tick, sizeof(sim->tick));
+    for (s32 i = 0; i < (s32) sim->entities.len; ++i) {
+        Entity *ent = sim->entities.arr + i;
+        hash = HashBytes(hash, &ent->tpe, sizeof(ent->tpe));
+        hash = HashBytes(hash, &ent->state, sizeof(ent->state));
+        hash = HashBytes(hash, &ent->facing_right, sizeof(ent->facing_right));
+        hash = HashBytes(hash, &ent->anchor, sizeof(ent->anchor));
+        hash = HashBytes(hash, &ent->velocity, sizeof(ent->velocity));
+        hash = HashBytes(hash, &ent->accel, sizeof(ent->accel));
+    }
+    return hash;
+}
+
+
+// transport
+
+struct RollbackPacket {
+    s32 from_tick;
+    s32 input_cnt;
+    u8 inputs[RB_HISTORY];
+    s32 ack_tick;
+    s32 checksum_tick;
+    u32 checksum;
+};
+
+struct RollbackTransport {
+    void *user;
+    void (*send)(void *user, s32 to_peer, RollbackPacket *packet);
+    bool (*recv)(void *user, s32 at_peer, RollbackPacket *out);
+};
+
+
+// loopback transport with artificial latency and packet loss, both peers in-process
+
+#define LOOPBACK_QUEUE_CAP 256
+
+struct LoopbackLink {
+    RollbackPacket packets[LOOPBACK_QUEUE_CAP];
+    f64 deliver_at[LOOPBACK_QUEUE_CAP];
+    s32 len;
+};
+
+struct LoopbackTransport {
+    LoopbackLink links[RB_MAX_PLAYERS]; // links[i] holds packets in flight to peer i
+    f64 now_ms;
+    f32 latency_ms;
+    f32 jitter_ms;
+    f32 loss; // [0, 1]
+    u32 rng;
+    s32 sent_cnt;
+    s32 dropped_cnt;
+};
+
+LoopbackTransport LoopbackInit(f32 latency_ms, f32 jitter_ms, f32 loss, u32 seed) {
+    LoopbackTransport lb = {};
+    lb.latency_ms = latency_ms;
+    lb.jitter_ms = jitter_ms;
+    lb.loss = loss;
+    lb.rng = seed ? seed : 1;
+    return lb;
+}
+
+f32 LoopbackRandom(LoopbackTransport *lb) {
+    // xorshift32
+    lb->rng ^= lb->rng << 13;
+    lb->rng ^= lb->rng >> 17;
+    lb->rng ^= lb->rng << 5;
+    return (lb->rng >> 8) / (f32) (1 << 24);
+}
+
+void LoopbackSend(void *user, s32 to_peer, RollbackPacket *packet) {
+    LoopbackTransport *lb = (LoopbackTransport*) user;
+    LoopbackLink *link = lb->links + to_peer;
+
+    lb->sent_cnt++;
+    if (LoopbackRandom(lb) < lb->loss || link->len == LOOPBACK_QUEUE_CAP) {
+        lb->dropped_cnt++;
+        return;
+    }
+
+    link->packets[link->len] = *packet;
+    link->deliver_at[link->len] = lb->now_ms + lb->latency_ms + lb->jitter_ms * LoopbackRandom(lb);
+    link->len++;
+}
+
+bool LoopbackRecv(void *user, s32 at_peer, RollbackPacket *out) {
+    LoopbackTransport *lb = (LoopbackTransport*) user;
+    LoopbackLink *link = lb->links + at_peer;
+
+    // jitter may reorder packets, deliver the earliest due one
+    s32 found = -1;
+    for (s32 i = 0; i < link->len; ++i) {
+        if (link->deliver_at[i] <= lb->now_ms) {
+            if (found == -1 || link->deliver_at[i] < link->deliver_at[found]) {
+                found = i;
+            }
+        }
+    }
+    if (found == -1) {
+        return false;
+    }
+
+    *out = link->packets[found];
+    link->len--;
+    link->packets[found] = link->packets[link->len];
+    link->deliver_at[found] = link->deliver_at[link->len];
+    return true;
+}
+
+void LoopbackAdvance(LoopbackTransport *lb, f32 dt_ms) {
+    lb->now_ms += dt_ms;
+}
+
+RollbackTransport LoopbackGetTransport(LoopbackTransport *lb) {
+    RollbackTransport tp = {};
+    tp.user = lb;
+    tp.send = LoopbackSend;
+    tp.recv = LoopbackRecv;
+    return tp;
+}
+
+
+// session
+
+struct RollbackSession {
+    RaceSim sim;
+    RollbackTransport transport;
+    s32 local;
+    s32 remote;
+    s32 max_rollback; // resimulation budget in ticks
+
+    // rings indexed by tick % RB_HISTORY
+    u8 inputs[RB_HISTORY][RB_MAX_PLAYERS];
+    u32 checksums[RB_HISTORY];
+    Entity *snapshots[RB_HISTORY]; // state before the tick was simulated
+    RaceSim snapshot_sims[RB_HISTORY];
+    s32 confirmed_tick[RB_MAX_PLAYERS]; // last tick with a received or local input
+    s32 remote_ack; // last local tick the remote has confirmed
+    s32 rollback_to; // earliest tick simulated with a wrong prediction, -1 if none
+
+    s32 remote_checksum_tick;
+    u32 remote_checksum;
+    s32 verified_tick;
+
+    // stats
+    s32 rollback_cnt;
+    s32 resim_cnt;
+    s32 resim_max;
+    s32 stall_cnt;
+    bool desync;
+    s32 desync_tick;
+};
+
+RollbackSession RollbackInit(MArena *a, CatLevel *level, s32 local, RollbackTransport transport) {
+    static_assert(RB_MAX_ROLLBACK_DEFAULT < RB_HISTORY, "rollback budget must fit in the history");
+
+    RollbackSession s = {};
+    s.sim = RaceSimInit(a, level, RB_MAX_PLAYERS);
+    s.transport = transport;
+    s.local = local;
+    s.remote = 1 - local;
+    s.max_rollback = RB_MAX_ROLLBACK_DEFAULT;
+    s.rollback_to = -1;
+    s.remote_ack = -1;
+    s.remote_checksum_tick = -1;
+    s.verified_tick = -1;
+    s.desync_tick = -1;
+    for (s32 p = 0; p < RB_MAX_PLAYERS; ++p) {
+        s.confirmed_tick[p] = -1;
+    }
+    for (s32 i = 0; i < RB_HISTORY; ++i) {
+        s.snapshots[i] = (Entity*) ArenaAlloc(a, sizeof(Entity) * s.sim.entities.len);
+    }
+    return s;
+}
+
+void RollbackSaveSnapshot(RollbackSession *s) {
+    s32 slot = s->sim.tick % RB_HISTORY;
+    memcpy(s->snapshots[slot], s->sim.entities.arr, sizeof(Entity) * s->sim.entities.len);
+    s->snapshot_sims[slot] = s->sim;
+}
+
+void RollbackLoadSnapshot(RollbackSession *s, s32 tick) {
+    assert(s->sim.tick - tick <= RB_HISTORY && "RollbackLoadSnapshot: tick is out of history");
+
+    s32 slot = tick % RB_HISTORY;
+    Array<Entity> entities = s->sim.entities;
+    memcpy(entities.arr, s->snapshots[slot], sizeof(Entity) * entities.len);
+    s->sim = s->snapshot_sims[slot];
+    s->sim.entities = entities;
+}
+
+// inputs the remote has not sent yet repeat its last known movement; jumps are
+// edge-triggered and are never repeated
+u8 RollbackPredict(RollbackSession *s, s32 player, s32 tick) {
+    s32 last = s->confirmed_tick[player];
+    if (last < 0 || tick - last >= RB_HISTORY) {
+        return 0;
+    }
+    CatInput input = UnpackInput(s->inputs[last % RB_HISTORY][player]);
+    input.jump = false;
+    return PackInput(input);
+}
+
+void RollbackSimulateTick(RollbackSession *s) {
+    s32 tick = s->sim.tick;
+    for (s32 p = 0; p < RB_MAX_PLAYERS; ++p) {
+        if (tick > s->confirmed_tick[p]) {
+            s->inputs[tick % RB_HISTORY][p] = RollbackPredict(s, p, tick);
+        }
+    }
+
+    CatInput inputs[RB_MAX_PLAYERS];
+    for (s32 p = 0; p < RB_MAX_PLAYERS; ++p) {
+        inputs[p] = UnpackInput(s->inputs[tick % RB_HISTORY][p]);
+    }
+
+    RollbackSaveSnapshot(s);
+    RaceSimStep(&s->sim, inputs, RB_TICK_MS);
+    s->checksums[tick % RB_HISTORY] = RaceSimChecksum(&s->sim);
+}
+
+void RollbackReceive(RollbackSession *s, RollbackPacket *packet) {
+    s32 p = s->remote;
+
+    for (s32 i = 0; i < packet->input_cnt; ++i) {
+        s32 tick = packet->from_tick + i;
+        if (tick != s->confirmed_tick[p] + 1) {
+            // already known, or a gap left by a lost packet
+            continue;
+        }
+        u8 input = packet->inputs[i];
+        if (tick < s->sim.tick && s->inputs[tick % RB_HISTORY][p] != input) {
+            if (s->rollback_to == -1 || tick < s->rollback_to) {
+                s->rollback_to = tick;
+            }
+        }
+        s->inputs[tick % RB_HISTORY][p] = input;
+        s->confirmed_tick[p] = tick;
+    }
+
+    if (packet->ack_tick > s->remote_ack) {
+        s->remote_ack = packet->ack_tick;
+    }
+    if (packet->checksum_tick > s->remote_checksum_tick) {
+        s->remote_checksum_tick = packet->checksum_tick;
+        s->remote_checksum = packet->checksum;
+    }
+}
+
+// the last tick whose inputs are all confirmed and that has been simulated
+s32 RollbackFinalTick(RollbackSession *s) {
+    s32 final = s->sim.tick - 1;
+    for (s32 p = 0; p < RB_MAX_PLAYERS; ++p) {
+        if (s->confirmed_tick[p] < final) {
+            final = s->confirmed_tick[p];
+        }
+    }
+    return final;
+}
+
+void RollbackVerifyChecksum(RollbackSession *s) {
+    s32 tick = s->remote_checksum_tick;
+    if (tick <= s->verified_tick || tick > RollbackFinalTick(s) || s->sim.tick - tick > RB_HISTORY) {
+        return;
+    }
+    if (s->checksums[tick % RB_HISTORY] != s->remote_checksum && !s->desync) {
+        s->desync = true;
+        s->desync_tick = tick;
+    }
+    s->verified_tick = tick;
+}
+
+void RollbackSend(RollbackSession *s) {
+    RollbackPacket packet = {};
+
+    // resend every input the remote has not acknowledged, so lost packets heal
+    s32 from = s->remote_ack + 1;
+    s32 to = s->confirmed_tick[s->local];
+    if (to - from + 1 > RB_HISTORY) {
+        from = to - RB_HISTORY + 1;
+    }
+    packet.from_tick = from;
+    packet.input_cnt = to - from + 1;
+    for (s32 i = 0; i < packet.input_cnt; ++i) {
+        packet.inputs[i] = s->inputs[(from + i) % RB_HISTORY][s->local];
+    }
+    packet.ack_tick = s->confirmed_tick[s->remote];
+
+    s32 final = RollbackFinalTick(s);
+    packet.checksum_tick = final;
+    if (final >= 0) {
+        packet.checksum = s->checksums[final % RB_HISTORY];
+    }
+
+    s->transport.send(s->transport.user, s->remote, &packet);
+}
+
+// advances the session by one tick with the local input; returns false when the
+// local peer is too far ahead of the remote and has to wait for it
+bool RollbackAdvance(RollbackSession *s, CatInput local_input) {
+    RollbackPacket packet = {};
+    while (s->transport.recv(s->transport.user, s->local, &packet)) {
+        RollbackReceive(s, &packet);
+    }
+
+    // restore and resimulate up to the present
+    if (s->rollback_to != -1) {
+        s32 present = s->sim.tick;
+        s32 resim = present - s->rollback_to;
+        assert(resim <= s->max_rollback && "RollbackAdvance: resimulation budget exceeded");
+
+        RollbackLoadSnapshot(s, s->rollback_to);
+        while (s->sim.tick < present) {
+            RollbackSimulateTick(s);
+        }
+
+        s->rollback_cnt++;
+        s->resim_cnt += resim;
+        if (resim > s->resim_max) {
+            s->resim_max = resim;
+        }
+        s->rollback_to = -1;
+    }
+    RollbackVerifyChecksum(s);
+
+    bool advanced = false;
+    if (s->sim.tick - s->confirmed_tick[s->remote] <= s->max_rollback) {
+        s32 tick = s->sim.tick;
+        s->inputs[tick % RB_HISTORY][s->local] = PackInput(local_input);
+        s->confirmed_tick[s->local] = tick;
+        RollbackSimulateTick(s);
+        advanced = true;
+    }
+    else {
+        s->stall_cnt++;
+    }
+
+    RollbackSend(s);
+    return advanced;
+}
+
+Entity *RollbackGetCat(RollbackSession *s, s32 player) {
+    return s->sim.entities.arr + s->sim.cat_idx[player];
+}
+
+
+#endif
@@ -0,0 +1,233 @@
+#ifndef __STATS_H__
+#define __STATS_H__
+
+
+// Stats.
+//
+// Counters and gauges for a live view of the game's load, published once a frame in
+// a POSIX shared memory segment that tools/catjump_stat.cpp reads without stopping
+// the game. Build with CATJUMP_STATS defined to turn them on; without it every STAT_*
+// macro is empty and nothing here is compiled in.
+//
+// Each job thread counts into its own cache lines, with a plain load and store, so
+// counting from inside jobs needs no locked instructions. Counters only ever grow;
+// StatsPublish sums the threads and publishes the difference to the last frame along
+// with the total. The segment is guarded by a sequence number, odd while a frame is
+// being written, so readers retry instead of seeing half a frame.
+
+
+// no shm_open on the web or on windows
+#if defined(CATJUMP_STATS) && (defined(__EMSCRIPTEN__) || defined(_WIN32))
+#undef CATJUMP_STATS
+#endif
+
+#include <atomic>
+
+#include "memory.h"
+#include "jobs.h"
+
+
+#define STATS_SHM_NAME "/catjump_stats"
+#define STATS_MAGIC 0x54534A43 // "CJST"
+#define STATS_VERSION 2
+#define STATS_NAME_LEN 32
+
+enum StatArena {
+    SA_LIFE,
+    SA_GEN,
+    SA_RACE,
+    SA_GHOST,
+
+    SA_CNT,
+};
+
+enum StatId {
+    // counters, per frame
+    STAT_COLL_TESTS_PLATFORM,
+    STAT_COLL_TESTS_WALL,
+    STAT_COLL_HITS_PLATFORM,
+    STAT_COLL_HITS_WALL,
+    STAT_TRIGGER_EVALS,
+    STAT_TRIGGER_TESTS,
+    STAT_ENTITIES_UPDATED,
+    STAT_DRAW_CALLS,
+
+    STAT_COUNTER_CNT,
+
+    // gauges, in bytes; one per StatArena
+    STAT_ARENA_USED = STAT_COUNTER_CNT,
+    STAT_ARENA_HIGH = STAT_ARENA_USED + SA_CNT,
+
+    STAT_CNT = STAT_ARENA_HIGH + SA_CNT,
+};
+
+const char *stat_names[STAT_CNT] = {
+    "coll_tests_platform",
+    "coll_tests_wall",
+    "coll_hits_platform",
+    "coll_hits_wall",
+    "trigger_evals",
+    "trigger_tests",
+    "entities_updated",
+    "draw_calls",
+
+    "arena_life_used",
+    "arena_gen_used",
+    "arena_race_used",
+    "arena_ghost_used",
+    "arena_life_high",
+    "arena_gen_high",
+    "arena_race_high",
+    "arena_ghost_high",
+};
+
+// the shared segment
+struct StatsShared {
+    u32 magic;
+    u32 version;
+    u32 stat_cnt;
+    s32 pid;
+    std::atomic<u32> seq;
+    std::atomic<u64> frame;
+    std::atomic<u64> value[STAT_CNT]; // counters: the last frame, gauges: now
+    std::atomic<u64> total[STAT_CNT]; // counters: since start, gauges: the peak
+    char names[STAT_CNT][STATS_NAME_LEN];
+};
+
+// a consistent copy of the segment; false when it kept changing under us
+bool StatsSnapshot(StatsShared *shared, u64 *frame, u64 *value, u64 *total) {
+    for (s32 attempt = 0; attempt < 100; ++attempt) {
+        u32 seq = shared->seq.load(std::memory_order_acquire);
+        if (seq & 1) {
+            continue;
+        }
+        *frame = shared->frame.load(std::memory_order_relaxed);
+        for (s32 i = 0; i < STAT_CNT; ++i) {
+            value[i] = shared->value[i].load(std::memory_order_relaxed);
+            total[i] = shared->total[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (shared->seq.load(std::memory_order_relaxed) == seq) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+#ifdef CATJUMP_STATS
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+struct StatsThread {
+    alignas(64) std::atomic<u64> counters[STAT_COUNTER_CNT];
+};
+
+struct Stats {
+    StatsThread threads[JOB_MAX_THREADS];
+    u64 published[STAT_COUNTER_CNT];
+    u64 gauges[STAT_CNT];
+    StatsShared *shared;
+};
+
+Stats stats;
+
+// only the calling thread writes its slot, so no read-modify-write needs to be atomic
+void StatsAdd(StatId id, u64 n) {
+    std::atomic<u64> &c = stats.threads[JobThreadIndex()].counters[id];
+    c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+void StatsSet(StatId id, u64 v) {
+    stats.gauges[id] = v;
+}
+
+// creates the segment; stats still count without it, nobody just sees them
+bool StatsInit() {
+    s32 fd = shm_open(STATS_SHM_NAME, O_CREAT | O_RDWR, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    if (ftruncate(fd, sizeof(StatsShared)) != 0) {
+        close(fd);
+        return false;
+    }
+    void *mem = mmap(NULL, sizeof(StatsShared), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        return false;
+    }
+
+    StatsShared *shared = (StatsShared*) mem;
+    memset(mem, 0, sizeof(StatsShared));
+    for (s32 i = 0; i < STAT_CNT; ++i) {
+        strncpy(shared->names[i], stat_names[i], STATS_NAME_LEN - 1);
+    }
+    shared->version = STATS_VERSION;
+    shared->stat_cnt = STAT_CNT;
+    shared->pid = (s32) getpid();
+    std::atomic_thread_fence(std::memory_order_release);
+    shared->magic = STATS_MAGIC;
+
+    stats.shared = shared;
+    return true;
+}
+
+// once a frame, on the main thread
+void StatsPublish() {
+    StatsShared *shared = stats.shared;
+    if (shared == NULL) {
+        return;
+    }
+
+    u32 seq = shared->seq.load(std::memory_order_relaxed);
+    shared->seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    for (s32 i = 0; i < STAT_COUNTER_CNT; ++i) {
+        u64 sum = 0;
+        for (s32 t = 0; t < JOB_MAX_THREADS; ++t) {
+            sum += stats.threads[t].counters[i].load(std::memory_order_relaxed);
+        }
+        shared->value[i].store(sum - stats.published[i], std::memory_order_relaxed);
+        shared->total[i].store(sum, std::memory_order_relaxed);
+        stats.published[i] = sum;
+    }
+    for (s32 i = STAT_COUNTER_CNT; i < STAT_CNT; ++i) {
+        u64 v = stats.gauges[i];
+        u64 peak = shared->total[i].load(std::memory_order_relaxed);
+        shared->value[i].store(v, std::memory_order_relaxed);
+        shared->total[i].store(v > peak ? v : peak, std::memory_order_relaxed);
+    }
+    shared->frame.store(shared->frame.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+    shared->seq.store(seq + 2, std::memory_order_release);
+}
+
+void StatsShutdown() {
+    if (stats.shared == NULL) {
+        return;
+    }
+    munmap(stats.shared, sizeof(StatsShared));
+    shm_unlink(STATS_SHM_NAME);
+    stats.shared = NULL;
+}
+
+#define STAT_ADD(id, n) StatsAdd(id, n)
+#define STAT_INC(id) StatsAdd(id, 1)
+#define STAT_SET(id, v) StatsSet(id, v)
+#define STAT_ARENA(sa, arena) (StatsSet((StatId) (STAT_ARENA_USED + (sa)), (arena)->used), StatsSet((StatId) (STAT_ARENA_HIGH + (sa)), (arena)->high))
+
+#else
+
+#define STAT_ADD(id, n) ((void) 0)
+#define STAT_INC(id) ((void) 0)
+#define STAT_SET(id, v) ((void) 0)
+#define STAT_ARENA(sa, arena) ((void) 0)
+
+#endif
+
+
+#endif
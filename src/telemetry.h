@@ -0,0 +1,203 @@
+#ifndef __TELEMETRY_H__
+#define __TELEMETRY_H__
+
+
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <thread>
+
+#include "memory.h"
+#include "pacing.h"
+
+
+// Telemetry.
+//
+// The game thread appends fixed-size records to a single-producer single-consumer
+// ring, and a writer thread drains the ring into a binary log, flushing it every
+// TELEMETRY_FLUSH_MS. Appending is two atomic loads, the record copy and a release
+// store. When the ring is full the record is dropped and counted rather than waiting
+// on the writer; the writer notes the loss in the log as a TE_DROPPED record.
+//
+// A log is a TelemetryHeader followed by records until the end of the file.
+// tools/catjump_telemetry.cpp decodes them. There is no writer thread on the web
+// build, so telemetry stays off there.
+
+
+#define TELEMETRY_MAGIC 0x4C544A43 // "CJTL"
+#define TELEMETRY_VERSION 1
+#define TELEMETRY_RING_CAP 4096 // records, a power of two
+#define TELEMETRY_DRAIN_MS 10
+#define TELEMETRY_FLUSH_MS 1000
+
+static_assert((TELEMETRY_RING_CAP & (TELEMETRY_RING_CAP - 1)) == 0, "telemetry ring capacity must be a power of two");
+
+enum TelemetryEventType {
+    TE_SESSION_START,
+    TE_LEVEL_ENTER,
+    TE_LEVEL_EXIT, // value: ms spent in the level
+    TE_FALL, // x, y: where the cat fell out
+    TE_JUMP, // x, y: where it took off
+    TE_FRAME_SPIKE, // value: the frame's ms
+    TE_DROPPED, // value: records lost to a full ring since the last TE_DROPPED
+
+    TE_CNT,
+};
+
+const char *telemetry_event_names[TE_CNT] = {
+    "session_start",
+    "level_enter",
+    "level_exit",
+    "fall",
+    "jump",
+    "frame_spike",
+    "dropped",
+};
+
+struct TelemetryHeader {
+    u32 magic;
+    u32 version;
+    u32 record_size;
+    u32 reserved;
+    s64 start_time; // unix seconds
+};
+
+struct TelemetryRecord {
+    u16 tpe;
+    s16 level; // -1 when not in a level
+    f32 value;
+    f64 time; // ms since the session started
+    f32 x;
+    f32 y;
+};
+
+static_assert(sizeof(TelemetryRecord) == 24, "telemetry records are written to disk as they are");
+
+// head and tail each on their own cache line, so the two threads only share a line
+// when one of them actually looks at the other's index
+struct TelemetryRing {
+    alignas(64) std::atomic<u32> head; // next slot the game thread writes
+    alignas(64) std::atomic<u32> tail; // next slot the writer reads
+    alignas(64) std::atomic<u32> dropped;
+    TelemetryRecord records[TELEMETRY_RING_CAP];
+};
+
+struct Telemetry {
+    bool on;
+    f64 t0;
+    FILE *file;
+    std::thread writer;
+    std::atomic<bool> quit;
+    TelemetryRing ring;
+};
+
+
+// ring
+
+bool TelemetryPush(TelemetryRing *ring, const TelemetryRecord &rec) {
+    u32 head = ring->head.load(std::memory_order_relaxed);
+    u32 tail = ring->tail.load(std::memory_order_acquire);
+    if (head - tail == TELEMETRY_RING_CAP) {
+        ring->dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    ring->records[head & (TELEMETRY_RING_CAP - 1)] = rec;
+    ring->head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+// writes out everything queued, in at most two runs where the ring wraps
+u32 TelemetryDrain(TelemetryRing *ring, FILE *file) {
+    u32 tail = ring->tail.load(std::memory_order_relaxed);
+    u32 head = ring->head.load(std::memory_order_acquire);
+    u32 cnt = head - tail;
+    if (cnt == 0) {
+        return 0;
+    }
+
+    u32 at = tail & (TELEMETRY_RING_CAP - 1);
+    u32 first = cnt < TELEMETRY_RING_CAP - at ? cnt : TELEMETRY_RING_CAP - at;
+    fwrite(ring->records + at, sizeof(TelemetryRecord), first, file);
+    fwrite(ring->records, sizeof(TelemetryRecord), cnt - first, file);
+
+    ring->tail.store(head, std::memory_order_release);
+    return cnt;
+}
+
+
+// logging
+
+// game thread only
+void TelemetryLog(Telemetry *tel, TelemetryEventType tpe, s32 level, f32 value = 0, f32 x = 0, f32 y = 0) {
+    if (tel->on == false) {
+        return;
+    }
+    TelemetryRecord rec = { (u16) tpe, (s16) level, value, PacerNow() - tel->t0, x, y };
+    TelemetryPush(&tel->ring, rec);
+}
+
+void TelemetryWriteDropped(Telemetry *tel) {
+    u32 dropped = tel->ring.dropped.exchange(0, std::memory_order_relaxed);
+    if (dropped) {
+        TelemetryRecord rec = { TE_DROPPED, -1, (f32) dropped, PacerNow() - tel->t0, 0, 0 };
+        fwrite(&rec, sizeof(rec), 1, tel->file);
+    }
+}
+
+void TelemetryWriterMain(Telemetry *tel) {
+    f64 last_flush = PacerNow();
+    while (true) {
+        // read before draining, so the last drain sees every record logged before quit
+        bool quit = tel->quit.load(std::memory_order_acquire);
+
+        TelemetryDrain(&tel->ring, tel->file);
+        TelemetryWriteDropped(tel);
+
+        f64 now = PacerNow();
+        if (quit || now - last_flush >= TELEMETRY_FLUSH_MS) {
+            fflush(tel->file);
+            last_flush = now;
+        }
+        if (quit) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(TELEMETRY_DRAIN_MS));
+    }
+}
+
+// starts logging to path; leaves telemetry off when the file cannot be created
+bool TelemetryInit(Telemetry *tel, const char *path) {
+    tel->on = false;
+#ifndef __EMSCRIPTEN__
+    tel->file = fopen(path, "wb");
+    if (tel->file == NULL) {
+        return false;
+    }
+
+    TelemetryHeader header = { TELEMETRY_MAGIC, TELEMETRY_VERSION, sizeof(TelemetryRecord), 0, (s64) time(NULL) };
+    fwrite(&header, sizeof(header), 1, tel->file);
+
+    tel->t0 = PacerNow();
+    tel->ring.head.store(0);
+    tel->ring.tail.store(0);
+    tel->ring.dropped.store(0);
+    tel->quit.store(false);
+    tel->writer = std::thread(TelemetryWriterMain, tel);
+    tel->on = true;
+#endif
+    return tel->on;
+}
+
+void TelemetryShutdown(Telemetry *tel) {
+    if (tel->on == false) {
+        return;
+    }
+    tel->on = false;
+    tel->quit.store(true, std::memory_order_release);
+    tel->writer.join();
+    fclose(tel->file);
+    tel->file = NULL;
+}
+
+
+#endif
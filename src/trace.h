@@ -0,0 +1,289 @@
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+
+#include <cstddef>
+
+#include "memory.h"
+
+// reading maps the file, which needs POSIX
+#if !defined(__EMSCRIPTEN__) && !defined(_WIN32)
+#define TRACE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+// Tick trace.
+//
+// The cat's state after every CatUpdate, stored by column: a file is a TraceHeader
+// followed by fixed-size chunks of TRACE_CHUNK_TICKS ticks, and within a chunk each
+// field is one contiguous, 64-byte aligned array. A query that looks at one field
+// reads only that field's bytes, and chunk i is at a known offset, so the reader maps
+// the file and walks the columns in place without parsing anything.
+//
+// The writer fills a chunk in memory and writes it out whole when it is full; the
+// last chunk is written partly filled, its header says how many ticks it holds.
+// tools/catjump_trace.cpp queries traces.
+
+
+#define TRACE_MAGIC 0x52544A43 // "CJTR"
+#define TRACE_CHUNK_MAGIC 0x4B484354 // "TCHK"
+#define TRACE_VERSION 1
+#define TRACE_CHUNK_TICKS 4096 // keeps every column a multiple of 64 bytes
+#define TRACE_NAME_LEN 16
+
+struct TraceChunkHeader {
+    u32 magic;
+    u32 tick_cnt;
+    u64 first_tick;
+    u8 pad[48];
+};
+
+struct TraceChunk {
+    TraceChunkHeader header;
+
+    f32 dt[TRACE_CHUNK_TICKS];
+    f32 anchor_x[TRACE_CHUNK_TICKS];
+    f32 anchor_y[TRACE_CHUNK_TICKS];
+    f32 velocity_x[TRACE_CHUNK_TICKS];
+    f32 velocity_y[TRACE_CHUNK_TICKS];
+    s16 level[TRACE_CHUNK_TICKS];
+    u8 state[TRACE_CHUNK_TICKS];
+    u8 frame_idx[TRACE_CHUNK_TICKS];
+    u8 coll[TRACE_CHUNK_TICKS]; // CatCollision flags
+};
+
+static_assert(sizeof(TraceChunkHeader) == 64, "trace columns stay 64-byte aligned");
+static_assert(sizeof(TraceChunk) % 64 == 0, "trace chunks stay 64-byte aligned");
+
+// the coll column holds the CatCollision flags of entities.h, which readers know as
+enum TraceColl {
+    TRACE_COLL_PLATFORM = 1 << 0,
+    TRACE_COLL_SNAP = 1 << 1, // landing moved anchor.y onto the platform
+    TRACE_COLL_WALL = 1 << 2,
+    TRACE_COLL_PORTAL = 1 << 3,
+};
+
+enum TraceColumn {
+    TC_DT,
+    TC_ANCHOR_X,
+    TC_ANCHOR_Y,
+    TC_VELOCITY_X,
+    TC_VELOCITY_Y,
+    TC_LEVEL,
+    TC_STATE,
+    TC_FRAME_IDX,
+    TC_COLL,
+
+    TC_CNT,
+};
+
+enum TraceColumnType {
+    TT_F32,
+    TT_S16,
+    TT_U8,
+};
+
+struct TraceColumnDesc {
+    char name[TRACE_NAME_LEN];
+    u32 tpe;
+    u32 offset; // from the start of a chunk
+};
+
+// describes the columns, so a reader can check the layout it was built with
+struct TraceHeader {
+    u32 magic;
+    u32 version;
+    u32 chunk_size;
+    u32 chunk_ticks;
+    u32 column_cnt;
+    u32 reserved[3];
+    TraceColumnDesc columns[TC_CNT];
+};
+
+const TraceColumnDesc trace_columns[TC_CNT] = {
+    { "dt", TT_F32, offsetof(TraceChunk, dt) },
+    { "x", TT_F32, offsetof(TraceChunk, anchor_x) },
+    { "y", TT_F32, offsetof(TraceChunk, anchor_y) },
+    { "vx", TT_F32, offsetof(TraceChunk, velocity_x) },
+    { "vy", TT_F32, offsetof(TraceChunk, velocity_y) },
+    { "level", TT_S16, offsetof(TraceChunk, level) },
+    { "state", TT_U8, offsetof(TraceChunk, state) },
+    { "frame", TT_U8, offsetof(TraceChunk, frame_idx) },
+    { "coll", TT_U8, offsetof(TraceChunk, coll) },
+};
+
+// chunks start on a 64-byte boundary in the file too
+#define TRACE_DATA_OFFSET (((sizeof(TraceHeader) + 63) / 64) * 64)
+
+TraceHeader InitTraceHeader() {
+    TraceHeader header = {};
+    header.magic = TRACE_MAGIC;
+    header.version = TRACE_VERSION;
+    header.chunk_size = sizeof(TraceChunk);
+    header.chunk_ticks = TRACE_CHUNK_TICKS;
+    header.column_cnt = TC_CNT;
+    for (s32 i = 0; i < TC_CNT; ++i) {
+        header.columns[i] = trace_columns[i];
+    }
+    return header;
+}
+
+
+// writing
+
+struct TraceWriter {
+    FILE *file;
+    u64 tick;
+    TraceChunk chunk; // the one being filled
+};
+
+bool TraceWriterOpen(TraceWriter *tw, const char *path) {
+    tw->tick = 0;
+    tw->file = fopen(path, "wb");
+    if (tw->file == NULL) {
+        return false;
+    }
+
+    u8 header[TRACE_DATA_OFFSET] = {};
+    TraceHeader th = InitTraceHeader();
+    memcpy(header, &th, sizeof(th));
+    fwrite(header, sizeof(header), 1, tw->file);
+
+    tw->chunk.header = { TRACE_CHUNK_MAGIC, 0, 0, {} };
+    return true;
+}
+
+void TraceWriterFlushChunk(TraceWriter *tw) {
+    TraceChunk *chunk = &tw->chunk;
+    if (chunk->header.tick_cnt == 0) {
+        return;
+    }
+    fwrite(chunk, sizeof(TraceChunk), 1, tw->file);
+    chunk->header = { TRACE_CHUNK_MAGIC, 0, tw->tick, {} };
+}
+
+// one tick, as the game has it
+struct TraceTick {
+    f32 dt;
+    s32 level;
+    f32 anchor_x;
+    f32 anchor_y;
+    f32 velocity_x;
+    f32 velocity_y;
+    s32 state;
+    s32 frame_idx;
+    u32 coll;
+};
+
+void TraceAdd(TraceWriter *tw, TraceTick tick) {
+    if (tw->file == NULL) {
+        return;
+    }
+    TraceChunk *chunk = &tw->chunk;
+    u32 i = chunk->header.tick_cnt++;
+    chunk->dt[i] = tick.dt;
+    chunk->anchor_x[i] = tick.anchor_x;
+    chunk->anchor_y[i] = tick.anchor_y;
+    chunk->velocity_x[i] = tick.velocity_x;
+    chunk->velocity_y[i] = tick.velocity_y;
+    chunk->level[i] = (s16) tick.level;
+    chunk->state[i] = (u8) tick.state;
+    chunk->frame_idx[i] = (u8) tick.frame_idx;
+    chunk->coll[i] = (u8) tick.coll;
+
+    tw->tick++;
+    if (chunk->header.tick_cnt == TRACE_CHUNK_TICKS) {
+        TraceWriterFlushChunk(tw);
+    }
+}
+
+void TraceWriterClose(TraceWriter *tw) {
+    if (tw->file == NULL) {
+        return;
+    }
+    TraceWriterFlushChunk(tw);
+    fclose(tw->file);
+    tw->file = NULL;
+}
+
+
+// reading
+
+struct TraceFile {
+    u8 *data;
+    u64 size;
+    const TraceHeader *header;
+    u32 chunk_cnt;
+    u64 tick_cnt;
+};
+
+// maps the trace at path; false when it is missing or not laid out like ours
+bool TraceOpen(TraceFile *tf, const char *path) {
+    *tf = {};
+#ifndef TRACE_MMAP
+    return false;
+#else
+    s32 fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st = {};
+    if (fstat(fd, &st) != 0 || (u64) st.st_size < TRACE_DATA_OFFSET) {
+        close(fd);
+        return false;
+    }
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    tf->data = (u8*) data;
+    tf->size = st.st_size;
+    tf->header = (const TraceHeader*) data;
+
+    TraceHeader expected = InitTraceHeader();
+    if (memcmp(tf->header, &expected, sizeof(TraceHeader)) != 0) {
+        munmap(data, tf->size);
+        *tf = {};
+        return false;
+    }
+
+    // a chunk that is not one, or says it holds more ticks than fit, makes the whole
+    // file unreadable; the queries index its columns by tick_cnt
+    tf->chunk_cnt = (u32) ((tf->size - TRACE_DATA_OFFSET) / sizeof(TraceChunk));
+    for (u32 i = 0; i < tf->chunk_cnt; ++i) {
+        const TraceChunk *chunk = (const TraceChunk*) (tf->data + TRACE_DATA_OFFSET) + i;
+        if (chunk->header.magic != TRACE_CHUNK_MAGIC || chunk->header.tick_cnt > TRACE_CHUNK_TICKS) {
+            munmap(data, tf->size);
+            *tf = {};
+            return false;
+        }
+        tf->tick_cnt += chunk->header.tick_cnt;
+    }
+
+    // the kernel can read ahead, queries go front to back
+    madvise(data, tf->size, MADV_SEQUENTIAL);
+    return true;
+#endif
+}
+
+const TraceChunk *TraceGetChunk(TraceFile *tf, u32 i) {
+    assert(i < tf->chunk_cnt);
+    return (const TraceChunk*) (tf->data + TRACE_DATA_OFFSET) + i;
+}
+
+void TraceClose(TraceFile *tf) {
+#ifdef TRACE_MMAP
+    if (tf->data) {
+        munmap(tf->data, tf->size);
+    }
+#endif
+    *tf = {};
+}
+
+
+#endif
@@ -0,0 +1,197 @@
+#ifndef __TRAJECTORY_H__
+#define __TRAJECTORY_H__
+
+
+#include <cmath>
+
+#include "raylib.h"
+#include "memory.h"
+
+
+// Closed-form motion under constant acceleration.
+//
+// Entity::Update integrates exactly along these arcs, so the times of impact below
+// are the times the simulation actually reaches, whatever the step length. Times are
+// in ms, like dt.
+
+
+#define TOI_NONE -1.0f
+
+struct Arc {
+    Vector2 p;
+    Vector2 v;
+    Vector2 a;
+};
+
+Vector2 ArcPosition(Arc arc, f32 t) {
+    return {
+        arc.p.x + arc.v.x * t + 0.5f * arc.a.x * t * t,
+        arc.p.y + arc.v.y * t + 0.5f * arc.a.y * t * t,
+    };
+}
+
+Vector2 ArcVelocity(Arc arc, f32 t) {
+    return { arc.v.x + arc.a.x * t, arc.v.y + arc.a.y * t };
+}
+
+// earliest t >= 0 at which p + v t + a t^2 / 2 == target while moving towards +inf,
+// i.e. the crossing from below; TOI_NONE if it never happens
+f32 SolveCrossingIncreasing(f32 p, f32 v, f32 a, f32 target) {
+    f32 c = p - target;
+    if (a == 0) {
+        if (v <= 0) {
+            return TOI_NONE;
+        }
+        f32 t = -c / v;
+        return t >= 0 ? t : TOI_NONE;
+    }
+
+    f32 disc = v * v - 2 * a * c;
+    if (disc < 0) {
+        return TOI_NONE;
+    }
+    f32 sq = sqrtf(disc);
+
+    // the root where the slope v + a t is positive is (-v + sq) / a for either sign
+    // of a; its conjugate form avoids cancellation when a is small
+    f32 t = (v + sq > 0) ? -2 * c / (v + sq) : (-v + sq) / a;
+    return t >= 0 ? t : TOI_NONE;
+}
+
+// Time at which a falling bottom edge lands on top of a one-way platform.
+//
+// feet is the arc of the bottom-left corner of a box of the given width. Platforms
+// only stop downward motion: an arc passing up through the platform lands on it on
+// the way down. Overlapping the top while not rising counts as an impact at t = 0.
+f32 ArcTimeOfImpactPlatform(Arc feet, f32 width, Rectangle platform, f32 max_t) {
+    f32 t = TOI_NONE;
+
+    bool on_top = feet.p.y > platform.y && feet.p.y < platform.y + platform.height;
+    if (on_top && feet.v.y >= 0) {
+        t = 0;
+    }
+    else {
+        t = SolveCrossingIncreasing(feet.p.y, feet.v.y, feet.a.y, platform.y);
+    }
+
+    if (t == TOI_NONE || t > max_t) {
+        return TOI_NONE;
+    }
+
+    f32 x = ArcPosition(feet, t).x;
+    if (x < platform.x + platform.width && x + width > platform.x) {
+        return t;
+    }
+    return TOI_NONE;
+}
+
+// Time at which the leading side of a box moving horizontally reaches a wall; left
+// walls stop leftward motion, right walls rightward motion.
+f32 ArcTimeOfImpactWall(Arc box, f32 width, f32 height, Rectangle wall, bool is_left, f32 max_t) {
+    f32 t = TOI_NONE;
+    if (is_left) {
+        // mirror so the left side moving left becomes an increasing crossing
+        t = SolveCrossingIncreasing(- box.p.x, - box.v.x, - box.a.x, - (wall.x + wall.width));
+    }
+    else {
+        t = SolveCrossingIncreasing(box.p.x + width, box.v.x, box.a.x, wall.x);
+    }
+
+    if (t == TOI_NONE || t > max_t) {
+        return TOI_NONE;
+    }
+
+    f32 y = ArcPosition(box, t).y;
+    if (y < wall.y + wall.height && y + height > wall.y) {
+        return t;
+    }
+    return TOI_NONE;
+}
+
+// Time at which a box sliding along a platform no longer overlaps it horizontally.
+f32 ArcTimeOfLeavingPlatform(Arc box, f32 width, Rectangle platform, f32 max_t) {
+    f32 t = TOI_NONE;
+    if (box.v.x > 0) {
+        t = SolveCrossingIncreasing(box.p.x, box.v.x, box.a.x, platform.x + platform.width);
+    }
+    else if (box.v.x < 0) {
+        t = SolveCrossingIncreasing(- (box.p.x + width), - box.v.x, - box.a.x, - platform.x);
+    }
+
+    if (t == TOI_NONE || t > max_t) {
+        return TOI_NONE;
+    }
+    return t;
+}
+
+
+// every t in [0, max_t] at which p + v t + a t^2 / 2 == target, ascending; returns
+// how many
+s32 SolveCrossings(f32 p, f32 v, f32 a, f32 target, f32 max_t, f32 *out) {
+    f32 c = p - target;
+    f32 roots[2];
+    s32 cnt = 0;
+    if (a == 0) {
+        if (v != 0) {
+            roots[cnt++] = -c / v;
+        }
+    }
+    else {
+        f32 disc = v * v - 2 * a * c;
+        if (disc >= 0) {
+            // one root in the stable form, the other from the product of the two
+            f32 sq = sqrtf(disc);
+            f32 q = v > 0 ? -(v + sq) : -(v - sq);
+            f32 r0 = q / a;
+            f32 r1 = q != 0 ? 2 * c / q : r0;
+            roots[cnt++] = r0 < r1 ? r0 : r1;
+            roots[cnt++] = r0 < r1 ? r1 : r0;
+        }
+    }
+
+    s32 n = 0;
+    for (s32 i = 0; i < cnt; ++i) {
+        if (roots[i] >= 0 && roots[i] <= max_t) {
+            out[n++] = roots[i];
+        }
+    }
+    return n;
+}
+
+bool ArcBoxOverlaps(Arc box, f32 width, f32 height, Rectangle rect, f32 t) {
+    Vector2 p = ArcPosition(box, t);
+    return p.x < rect.x + rect.width && p.x + width > rect.x && p.y < rect.y + rect.height && p.y + height > rect.y;
+}
+
+// Time at which a box starts to overlap a rectangle, 0 if it already does. Overlap
+// only changes where a side of the box crosses a side of the rectangle, so those
+// crossings are the only candidates, each checked just after it.
+f32 ArcTimeOfEnteringRect(Arc box, f32 width, f32 height, Rectangle rect, f32 max_t) {
+    f32 times[9];
+    s32 cnt = 0;
+    times[cnt++] = 0;
+    cnt += SolveCrossings(box.p.x, box.v.x, box.a.x, rect.x - width, max_t, times + cnt);
+    cnt += SolveCrossings(box.p.x, box.v.x, box.a.x, rect.x + rect.width, max_t, times + cnt);
+    cnt += SolveCrossings(box.p.y, box.v.y, box.a.y, rect.y - height, max_t, times + cnt);
+    cnt += SolveCrossings(box.p.y, box.v.y, box.a.y, rect.y + rect.height, max_t, times + cnt);
+
+    // a handful, insertion sort
+    for (s32 i = 1; i < cnt; ++i) {
+        for (s32 j = i; j > 0 && times[j] < times[j - 1]; --j) {
+            f32 tmp = times[j];
+            times[j] = times[j - 1];
+            times[j - 1] = tmp;
+        }
+    }
+
+    for (s32 i = 0; i < cnt; ++i) {
+        f32 next = i + 1 < cnt ? times[i + 1] : max_t;
+        if (ArcBoxOverlaps(box, width, height, rect, times[i]) || ArcBoxOverlaps(box, width, height, rect, 0.5f * (times[i] + next))) {
+            return times[i];
+        }
+    }
+    return TOI_NONE;
+}
+
+
+#endif
@@ -0,0 +1,318 @@
+#ifndef __TRIGGERS_H__
+#define __TRIGGERS_H__
+
+
+#include <cmath>
+
+#include "raylib.h"
+#include "memory.h"
+#include "jobs.h"
+#include "stats.h"
+
+
+// Trigger volumes.
+//
+// Areas that do something to the cat in them: the portal out of the level,
+// checkpoints, and the kill zone under the level. A volume is snapped outwards to
+// whole cells of TRIGGER_CELL units, so whether the cat is in it depends only on
+// which cells the cat covers. The cat's TriggerContact keeps
+// those cells and the volumes it was in: while the cells stay the same nothing is
+// tested, and when they change, only the volumes listed in the rows the cat covers
+// are (CSR per row, like the collision grid). A level with thousands of triggers
+// costs what a level with one does.
+//
+// What changed comes out as events on a TriggerQueue: enter and exit when the cat's
+// cells come to meet or leave a volume, and stay for every volume it is still in.
+
+
+#define TRIGGER_CELL 16.0f
+#define TRIGGER_COLS 64
+#define TRIGGER_X0 (- 2 * TRIGGER_CELL)
+#define TRIGGER_ROW_NONE 0x3FFFFFFF // the last row of a volume with no bottom
+#define TRIGGER_INSIDE_MAX 8 // volumes the cat can be in at once; more are dropped, and assert in debug
+#define TRIGGER_QUEUE_CAP (3 * TRIGGER_INSIDE_MAX)
+
+enum TriggerKind {
+    TK_PORTAL,
+    TK_CHECKPOINT,
+    TK_KILL,
+
+    TK_CNT,
+};
+
+enum TriggerEventType {
+    TR_ENTER,
+    TR_STAY,
+    TR_EXIT,
+};
+
+// cells, inclusive; rows count from y = 0
+struct TriggerSpan {
+    s32 c0;
+    s32 c1;
+    s32 r0;
+    s32 r1;
+};
+
+struct TriggerVolume {
+    TriggerKind kind;
+    TriggerSpan span;
+    Vector2 at; // checkpoints: where the cat comes back
+};
+
+struct TriggerSet {
+    Array<TriggerVolume> volumes;
+    s32 row0;
+    s32 rows;
+    u64 *bits; // per row, the columns some volume covers
+    u32 *row_start;
+    u32 *idx;
+};
+
+// one cat's; copying it is enough to save and restore it
+struct TriggerContact {
+    TriggerSpan span; // at the last evaluation
+    s32 inside[TRIGGER_INSIDE_MAX];
+    s32 inside_cnt;
+};
+
+struct TriggerEvent {
+    u8 tpe;
+    u8 kind;
+    s32 idx; // into the set's volumes
+};
+
+struct TriggerQueue {
+    TriggerEvent events[TRIGGER_QUEUE_CAP];
+    s32 len;
+};
+
+s32 TriggerCol(f32 x) {
+    s32 c = (s32) floorf((x - TRIGGER_X0) / TRIGGER_CELL);
+    return c < 0 ? 0 : (c >= TRIGGER_COLS ? TRIGGER_COLS - 1 : c);
+}
+
+s32 TriggerRow(f32 y) {
+    return (s32) floorf(y / TRIGGER_CELL);
+}
+
+TriggerSpan TriggerSpanOf(Rectangle r) {
+    return { TriggerCol(r.x), TriggerCol(r.x + r.width), TriggerRow(r.y), TriggerRow(r.y + r.height) };
+}
+
+Rectangle TriggerSpanRect(TriggerSpan s) {
+    return { TRIGGER_X0 + s.c0 * TRIGGER_CELL, s.r0 * TRIGGER_CELL, (s.c1 - s.c0 + 1) * TRIGGER_CELL, (f32) (s.r1 - s.r0 + 1) * TRIGGER_CELL };
+}
+
+bool TriggerSpanEq(TriggerSpan a, TriggerSpan b) {
+    return a.c0 == b.c0 && a.c1 == b.c1 && a.r0 == b.r0 && a.r1 == b.r1;
+}
+
+bool TriggerSpanOverlap(TriggerSpan a, TriggerSpan b) {
+    return a.c0 <= b.c1 && b.c0 <= a.c1 && a.r0 <= b.r1 && b.r0 <= a.r1;
+}
+
+TriggerVolume InitTriggerVolume(TriggerKind kind, Rectangle rect, Vector2 at = {}) {
+    TriggerVolume vol = {};
+    vol.kind = kind;
+    vol.span = TriggerSpanOf(rect);
+    vol.at = at;
+    return vol;
+}
+
+// everything below y, the whole width of the column
+TriggerVolume InitKillZone(f32 y) {
+    TriggerVolume vol = {};
+    vol.kind = TK_KILL;
+    vol.span = { 0, TRIGGER_COLS - 1, TriggerRow(y), TRIGGER_ROW_NONE };
+    return vol;
+}
+
+
+// building
+
+// bits c0 through c1 inclusive
+u64 TriggerColMask(s32 c0, s32 c1) {
+    u64 ones = ~(u64) 0;
+    return (ones >> (63 - (c1 - c0))) << c0;
+}
+
+// built in row bands over the job threads, like BuildCollGridLayer
+struct TriggerBuildJob {
+    TriggerSet *set;
+    s32 band_rows;
+};
+
+void TriggerBuildBands(void *data, s32 lo, s32 hi, bool fill) {
+    TriggerBuildJob *job = (TriggerBuildJob*) data;
+    TriggerSet *set = job->set;
+    s32 band_r0 = lo * job->band_rows;
+    s32 band_r1 = hi * job->band_rows - 1;
+    band_r1 = band_r1 >= set->rows ? set->rows - 1 : band_r1;
+
+    for (u32 i = 0; i < set->volumes.len; ++i) {
+        TriggerSpan s = set->volumes.arr[i].span;
+        s32 r0 = s.r0 - set->row0;
+        s32 r1 = s.r1 - set->row0;
+        r0 = r0 < band_r0 ? band_r0 : r0;
+        r1 = r1 > band_r1 ? band_r1 : r1;
+        for (s32 row = r0; row <= r1; ++row) {
+            if (fill) {
+                set->idx[set->row_start[row]++] = i;
+            }
+            else {
+                set->bits[row] |= TriggerColMask(s.c0, s.c1);
+                set->row_start[row + 1]++;
+            }
+        }
+    }
+}
+
+void TriggerCountBands(void *data, s32 lo, s32 hi) {
+    TriggerBuildBands(data, lo, hi, false);
+}
+
+void TriggerFillBands(void *data, s32 lo, s32 hi) {
+    TriggerBuildBands(data, lo, hi, true);
+}
+
+// jobs may be NULL to build on the caller
+TriggerSet BuildTriggerSet(MArena *a, Array<TriggerVolume> volumes, JobSystem *jobs) {
+    TriggerSet set = {};
+    set.volumes = volumes;
+    if (volumes.len == 0) {
+        return set;
+    }
+
+    // rows from the highest top to the lowest bottom, or top for volumes with none
+    s32 row0 = volumes.arr[0].span.r0;
+    s32 row1 = row0;
+    for (u32 i = 0; i < volumes.len; ++i) {
+        TriggerSpan s = volumes.arr[i].span;
+        s32 bottom = s.r1 == TRIGGER_ROW_NONE ? s.r0 : s.r1;
+        row0 = s.r0 < row0 ? s.r0 : row0;
+        row1 = bottom > row1 ? bottom : row1;
+    }
+    set.row0 = row0;
+    set.rows = row1 - row0 + 1;
+    set.bits = (u64*) ArenaAlloc(a, sizeof(u64) * set.rows);
+    set.row_start = (u32*) ArenaAlloc(a, sizeof(u32) * (set.rows + 1));
+
+    s32 band_cnt = jobs != NULL ? jobs->thread_cnt : 1;
+    band_cnt = band_cnt > set.rows ? set.rows : band_cnt;
+    TriggerBuildJob job = { &set, (set.rows + band_cnt - 1) / band_cnt };
+
+    // counted into row_start[r + 1] and summed, then filled like BuildCollGridLayer
+    ParallelFor(jobs, band_cnt, 1, TriggerCountBands, &job);
+    for (s32 row = 0; row < set.rows; ++row) {
+        set.row_start[row + 1] += set.row_start[row];
+    }
+    set.idx = (u32*) ArenaAlloc(a, sizeof(u32) * set.row_start[set.rows]);
+
+    ParallelFor(jobs, band_cnt, 1, TriggerFillBands, &job);
+    for (s32 row = set.rows; row > 0; --row) {
+        set.row_start[row] = set.row_start[row - 1];
+    }
+    set.row_start[0] = 0;
+
+    return set;
+}
+
+
+// contacts
+
+// in nothing yet; the next update evaluates whatever the cells are
+TriggerContact InitTriggerContact() {
+    TriggerContact contact = {};
+    contact.span = { 1, 0, 1, 0 };
+    return contact;
+}
+
+bool TriggerContactIn(const TriggerSet *set, const TriggerContact *contact, TriggerKind kind) {
+    for (s32 i = 0; i < contact->inside_cnt; ++i) {
+        if (set->volumes.arr[contact->inside[i]].kind == kind) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void TriggerQueueClear(TriggerQueue *q) {
+    q->len = 0;
+}
+
+void TriggerPush(TriggerQueue *q, const TriggerSet *set, TriggerEventType tpe, s32 idx) {
+    assert(q->len < TRIGGER_QUEUE_CAP);
+    q->events[q->len++] = { (u8) tpe, (u8) set->volumes.arr[idx].kind, idx };
+}
+
+bool TriggerInList(const s32 *list, s32 cnt, s32 idx) {
+    for (s32 i = 0; i < cnt; ++i) {
+        if (list[i] == idx) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// the cat covers area now; queues what that changes. Exits come first, then enters
+// and stays in the order the volumes were found.
+void TriggerUpdate(const TriggerSet *set, TriggerContact *contact, Rectangle area, TriggerQueue *events) {
+    TriggerSpan span = TriggerSpanOf(area);
+    if (TriggerSpanEq(span, contact->span)) {
+        for (s32 i = 0; i < contact->inside_cnt; ++i) {
+            TriggerPush(events, set, TR_STAY, contact->inside[i]);
+        }
+        return;
+    }
+    contact->span = span;
+
+    s32 inside[TRIGGER_INSIDE_MAX];
+    s32 inside_cnt = 0;
+    if (set->rows > 0) {
+        s32 g0 = span.r0 - set->row0;
+        s32 g1 = span.r1 - set->row0;
+        g0 = g0 < 0 ? 0 : (g0 >= set->rows ? set->rows - 1 : g0);
+        g1 = g1 < 0 ? 0 : (g1 >= set->rows ? set->rows - 1 : g1);
+        u64 mask = TriggerColMask(span.c0, span.c1);
+
+        for (s32 row = g0; row <= g1; ++row) {
+            if ((set->bits[row] & mask) == 0) {
+                continue;
+            }
+            for (u32 j = set->row_start[row]; j < set->row_start[row + 1]; ++j) {
+                s32 idx = set->idx[j];
+                TriggerSpan s = set->volumes.arr[idx].span;
+
+                // a volume over several rows is only looked at in the first one searched
+                s32 first = s.r0 - set->row0;
+                if ((first > g0 ? first : g0) != row) {
+                    continue;
+                }
+                STAT_INC(STAT_TRIGGER_TESTS);
+                // past the limit the rest are not tracked, release builds included
+                bool overlap = TriggerSpanOverlap(s, span);
+                assert((overlap == false || inside_cnt < TRIGGER_INSIDE_MAX) && "more volumes overlap than a contact tracks");
+                if (overlap && inside_cnt < TRIGGER_INSIDE_MAX) {
+                    inside[inside_cnt++] = idx;
+                }
+            }
+        }
+    }
+
+    for (s32 i = 0; i < contact->inside_cnt; ++i) {
+        if (TriggerInList(inside, inside_cnt, contact->inside[i]) == false) {
+            TriggerPush(events, set, TR_EXIT, contact->inside[i]);
+        }
+    }
+    for (s32 i = 0; i < inside_cnt; ++i) {
+        bool was_in = TriggerInList(contact->inside, contact->inside_cnt, inside[i]);
+        TriggerPush(events, set, was_in ? TR_STAY : TR_ENTER, inside[i]);
+    }
+    memcpy(contact->inside, inside, sizeof(s32) * inside_cnt);
+    contact->inside_cnt = inside_cnt;
+    STAT_INC(STAT_TRIGGER_EVALS);
+}
+
+
+#endif
@@ -0,0 +1,206 @@
+// Generates levels headlessly, in batches over all cores.
+//
+//   catjump_levelgen <seed> <cnt> [-p <platforms>] [-d <difficulty>] [-t <threads>] [-r <ms>] [-o <file>]
+//
+// Levels get seeds seed .. seed + cnt - 1 and are generated with GenerateLevelBatch,
+// a round of a few levels per job thread at a time, each thread into its own arena.
+// Every level is then generated again on its own and compared with its batch copy.
+// Prints a line per level and the time both ways; -o writes the levels' geometry,
+// movers and checkpoints to a text file. Exits with 1 if any level differs.
+//
+// -r also loads every level and runs its cat for up to that many ms with right and
+// jump held, stepping event to event (see headless.h), a level per job. Each line
+// then says how the run ended, when, and the highest the cat stood.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "levelgen.h"
+#include "headless.h"
+#include "pacing.h"
+
+
+#define LEVELS_PER_THREAD 4 // per round
+#define RUN_ARENA_SCALE 8 // a loaded level's grid, triggers and pools, over its generated size
+
+JobSystem jobs;
+
+void WriteLevel(FILE *f, const LevelDesc *desc, u64 seed, u64 hash) {
+    fprintf(f, "level %s seed %llu hash %016llx\n", desc->name, (unsigned long long) seed, (unsigned long long) hash);
+    fprintf(f, "spawn %.2f %.2f\n", desc->spawn.x, desc->spawn.y);
+    fprintf(f, "trapdoor %.2f %.2f\n", desc->trapdoor.x, desc->trapdoor.y);
+    fprintf(f, "portal %.2f %.2f\n", desc->portal.x, desc->portal.y);
+    for (s32 i = 0; i < desc->geometry_cnt; ++i) {
+        const Entity *ent = desc->geometry + i;
+        const char *tpe = ent->tpe == ET_PLATFORM ? "platform" : (ent->tpe == ET_WALL_LEFT ? "wall_left" : "wall_right");
+        fprintf(f, "%s %.2f %.2f %.2f %.2f\n", tpe, ent->coll_rect.x, ent->coll_rect.y, ent->coll_rect.width, ent->coll_rect.height);
+    }
+    for (s32 i = 0; i < desc->mover_cnt; ++i) {
+        const LevelMover *m = desc->movers + i;
+        fprintf(f, "mover %.2f %.2f %.2f sine %.2f %.2f %.1f %.4f\n", m->path.origin.x, m->path.origin.y, m->ent.coll_rect.width,
+            m->path.amplitude.x, m->path.amplitude.y, m->path.period, m->path.phase);
+    }
+    for (s32 i = 0; i < desc->checkpoint_cnt; ++i) {
+        fprintf(f, "checkpoint %.2f %.2f\n", desc->checkpoints[i].x, desc->checkpoints[i].y);
+    }
+}
+
+struct LevelRunJob {
+    LevelDesc *descs;
+    HeadlessRun *runs;
+    MArena *arenas;
+    LevelDefaults defaults;
+    f64 max_time;
+};
+
+void LevelRunRange(void *data, s32 lo, s32 hi) {
+    LevelRunJob *job = (LevelRunJob*) data;
+    MArena *a = job->arenas + JobThreadIndex();
+    CatInput input = { false, true, true };
+    for (s32 i = lo; i < hi; ++i) {
+        ArenaClear(a);
+        CatLevel level = LoadLevel(a, job->descs + i, &job->defaults, NULL);
+        job->runs[i] = RunHeadless(&level, input, job->max_time);
+    }
+}
+
+const char *RunEndName(CatEventType end) {
+    return end == CE_EXIT ? "exit" : (end == CE_FALL_OUT ? "fell" : "time");
+}
+
+s32 Usage(const char *name) {
+    fprintf(stderr, "usage: %s <seed> <cnt> [-p <platforms>] [-d <difficulty>] [-t <threads>] [-r <ms>] [-o <file>]\n", name);
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        return Usage(argv[0]);
+    }
+    LevelGenParams params = { strtoull(argv[1], NULL, 10), 10000, 0.5f, 0.02f, 10 };
+    s32 cnt = atoi(argv[2]);
+    s32 thread_cnt = JobDefaultThreadCount();
+    const char *out_path = NULL;
+    f64 run_ms = 0;
+    for (s32 arg = 3; arg < argc; ++arg) {
+        if (strcmp(argv[arg], "-p") == 0 && arg + 1 < argc) {
+            params.platform_cnt = atoi(argv[++arg]);
+        }
+        else if (strcmp(argv[arg], "-d") == 0 && arg + 1 < argc) {
+            params.difficulty = (f32) atof(argv[++arg]);
+        }
+        else if (strcmp(argv[arg], "-t") == 0 && arg + 1 < argc) {
+            thread_cnt = atoi(argv[++arg]);
+        }
+        else if (strcmp(argv[arg], "-r") == 0 && arg + 1 < argc) {
+            run_ms = atof(argv[++arg]);
+        }
+        else if (strcmp(argv[arg], "-o") == 0 && arg + 1 < argc) {
+            out_path = argv[++arg];
+        }
+        else {
+            return Usage(argv[0]);
+        }
+    }
+    if (cnt <= 0 || params.platform_cnt < 0) {
+        return Usage(argv[0]);
+    }
+
+    FILE *out = NULL;
+    if (out_path != NULL) {
+        out = fopen(out_path, "w");
+        if (out == NULL) {
+            fprintf(stderr, "%s: cannot open\n", out_path);
+            return 1;
+        }
+    }
+
+    JobSystemInit(&jobs, thread_cnt);
+    s32 round = jobs.thread_cnt * LEVELS_PER_THREAD;
+
+    // any thread may end up with the whole round, stealing is not fair
+    u64 arena_cap = LevelGenArenaSize(params) * round;
+    MArena arenas[JOB_MAX_THREADS];
+    for (s32 i = 0; i < jobs.thread_cnt; ++i) {
+        arenas[i] = ArenaCreate(malloc(arena_cap), arena_cap);
+    }
+    u64 alone_cap = LevelGenArenaSize(params);
+    MArena alone = ArenaCreate(malloc(alone_cap), alone_cap);
+    LevelDesc *descs = (LevelDesc*) malloc(sizeof(LevelDesc) * round);
+
+    MArena run_arenas[JOB_MAX_THREADS];
+    HeadlessRun *runs = NULL;
+    LevelRunJob run_job = {};
+    if (run_ms > 0) {
+        u64 run_cap = LevelGenArenaSize(params) * RUN_ARENA_SCALE + (1 << 20);
+        for (s32 i = 0; i < jobs.thread_cnt; ++i) {
+            run_arenas[i] = ArenaCreate(malloc(run_cap), run_cap);
+        }
+        runs = (HeadlessRun*) malloc(sizeof(HeadlessRun) * round);
+        run_job = { descs, runs, run_arenas, InitHeadlessLevelDefaults(), run_ms };
+    }
+
+    f64 batch_ms = 0;
+    f64 alone_ms = 0;
+    f64 run_total_ms = 0;
+    s64 run_events = 0;
+    s64 run_ticks = 0;
+    s32 differ = 0;
+    for (s32 first = 0; first < cnt; first += round) {
+        s32 n = cnt - first < round ? cnt - first : round;
+        for (s32 i = 0; i < jobs.thread_cnt; ++i) {
+            ArenaClear(arenas + i);
+        }
+
+        LevelGenParams p = params;
+        p.seed = params.seed + first;
+        f64 t0 = PacerNow();
+        GenerateLevelBatch(&jobs, p, descs, n, arenas);
+        batch_ms += PacerNow() - t0;
+
+        if (runs != NULL) {
+            f64 t2 = PacerNow();
+            ParallelFor(&jobs, n, 1, LevelRunRange, &run_job);
+            run_total_ms += PacerNow() - t2;
+        }
+
+        for (s32 i = 0; i < n; ++i) {
+            LevelGenParams q = params;
+            q.seed = p.seed + i;
+            ArenaClear(&alone);
+            f64 t1 = PacerNow();
+            LevelDesc desc = GenerateLevel(&alone, q);
+            alone_ms += PacerNow() - t1;
+
+            u64 hash = LevelDescHash(descs + i);
+            bool same = hash == LevelDescHash(&desc) && strcmp(desc.name, descs[i].name) == 0;
+            differ += same ? 0 : 1;
+            printf("%10llu  %s  platforms %6d  movers %5d  checkpoints %5d  top %10.1f  hash %016llx  %s\n",
+                (unsigned long long) q.seed, descs[i].name, descs[i].geometry_cnt - 3, descs[i].mover_cnt, descs[i].checkpoint_cnt,
+                descs[i].portal.y, (unsigned long long) hash, same ? "ok" : "DIFFERS");
+            if (runs != NULL) {
+                printf("%10s  run %s at %.0f ms  stood %10.1f  events %6d  ticks %6d\n", "", RunEndName(runs[i].end),
+                    runs[i].time, runs[i].top, runs[i].events, runs[i].ticks);
+                run_events += runs[i].events;
+                run_ticks += runs[i].ticks;
+            }
+            if (out != NULL) {
+                WriteLevel(out, descs + i, q.seed, hash);
+            }
+        }
+    }
+
+    fprintf(stderr, "%d levels of %d platforms: %.1f ms in batches on %d threads, %.1f ms one by one; %d differ\n",
+        cnt, params.platform_cnt, batch_ms, jobs.thread_cnt, alone_ms, differ);
+    if (runs != NULL) {
+        fprintf(stderr, "runs of up to %.0f ms: %.1f ms, %lld events and %lld ticks\n",
+            run_ms, run_total_ms, (long long) run_events, (long long) run_ticks);
+    }
+
+    if (out != NULL) {
+        fclose(out);
+    }
+    JobSystemShutdown(&jobs);
+    return differ > 0 ? 1 : 0;
+}
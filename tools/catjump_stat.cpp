@@ -0,0 +1,102 @@
+// Live view of a running game's stats, for games built with CATJUMP_STATS.
+//
+//   catjump_stat [-1] [-i <ms>]
+//
+// Reads the shared memory segment the game publishes every frame and prints every
+// interval (1000 ms by default) until interrupted; -1 prints once and exits.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "stats.h"
+#include "pacing.h"
+
+
+int main(int argc, char **argv) {
+    bool once = false;
+    s32 interval_ms = 1000;
+    for (s32 i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-1") == 0) {
+            once = true;
+        }
+        else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+            interval_ms = atoi(argv[++i]);
+            interval_ms = interval_ms < 10 ? 10 : interval_ms;
+        }
+        else {
+            fprintf(stderr, "usage: %s [-1] [-i <ms>]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    s32 fd = shm_open(STATS_SHM_NAME, O_RDONLY, 0);
+    if (fd < 0) {
+        fprintf(stderr, "no stats at %s; is the game running, built with CATJUMP_STATS?\n", STATS_SHM_NAME);
+        return 1;
+    }
+    void *mem = mmap(NULL, sizeof(StatsShared), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        fprintf(stderr, "%s: cannot map\n", STATS_SHM_NAME);
+        return 1;
+    }
+
+    StatsShared *shared = (StatsShared*) mem;
+    if (shared->magic != STATS_MAGIC || shared->version != STATS_VERSION || shared->stat_cnt != STAT_CNT) {
+        fprintf(stderr, "%s: version %u with %u stats, expected version %u with %u\n", STATS_SHM_NAME,
+            shared->version, shared->stat_cnt, STATS_VERSION, (u32) STAT_CNT);
+        return 1;
+    }
+
+    u64 frame = 0;
+    u64 value[STAT_CNT] = {};
+    u64 total[STAT_CNT] = {};
+    u64 last_frame = 0;
+    u64 last_total[STAT_CNT] = {};
+    f64 last_time = PacerNow();
+    bool first = true;
+
+    while (true) {
+        if (StatsSnapshot(shared, &frame, value, total) == false) {
+            fprintf(stderr, "%s: could not get a consistent snapshot\n", STATS_SHM_NAME);
+            return 1;
+        }
+        f64 now = PacerNow();
+        f64 secs = (now - last_time) / 1000;
+
+        printf("pid %d  frame %llu", shared->pid, (unsigned long long) frame);
+        if (first == false && secs > 0) {
+            printf("  %.1f fps", (frame - last_frame) / secs);
+        }
+        printf("\n%-24s %14s %14s %16s\n", "", "last frame", "per second", "total / peak");
+
+        for (s32 i = 0; i < STAT_CNT; ++i) {
+            printf("%-24s %14llu ", shared->names[i], (unsigned long long) value[i]);
+            if (i < STAT_COUNTER_CNT && first == false && secs > 0) {
+                printf("%14.0f ", (total[i] - last_total[i]) / secs);
+            }
+            else {
+                printf("%14s ", "");
+            }
+            printf("%16llu\n", (unsigned long long) total[i]);
+            last_total[i] = total[i];
+        }
+        printf("\n");
+        fflush(stdout);
+
+        if (once) {
+            break;
+        }
+        first = false;
+        last_frame = frame;
+        last_time = now;
+        usleep(interval_ms * 1000);
+    }
+
+    munmap(mem, sizeof(StatsShared));
+    return 0;
+}
@@ -0,0 +1,127 @@
+// Decodes a telemetry log written with CATJUMP_TELEMETRY set.
+//
+//   catjump_telemetry [-s] <log>
+//
+// Prints one line per record, then a summary per level; -s prints only the summary.
+
+#include <cstdio>
+#include <cstring>
+
+#include "telemetry.h"
+
+
+#define MAX_LEVELS 64
+
+struct LevelSummary {
+    s32 enters;
+    s32 exits;
+    s32 falls;
+    s32 jumps;
+    f64 exit_ms_sum;
+    f32 exit_ms_best;
+};
+
+int main(int argc, char **argv) {
+    bool summary_only = false;
+    const char *path = NULL;
+    for (s32 i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-s") == 0) {
+            summary_only = true;
+        }
+        else {
+            path = argv[i];
+        }
+    }
+    if (path == NULL) {
+        fprintf(stderr, "usage: %s [-s] <log>\n", argv[0]);
+        return 1;
+    }
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "%s: cannot open\n", path);
+        return 1;
+    }
+
+    TelemetryHeader header = {};
+    if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != TELEMETRY_MAGIC) {
+        fprintf(stderr, "%s: not a telemetry log\n", path);
+        return 1;
+    }
+    if (header.version != TELEMETRY_VERSION || header.record_size != sizeof(TelemetryRecord)) {
+        fprintf(stderr, "%s: version %u with %u byte records, expected version %u with %u\n", path,
+            header.version, header.record_size, TELEMETRY_VERSION, (u32) sizeof(TelemetryRecord));
+        return 1;
+    }
+
+    char started[64] = {};
+    time_t start_time = (time_t) header.start_time;
+    strftime(started, sizeof(started), "%Y-%m-%d %H:%M:%S", localtime(&start_time));
+    printf("session started %s\n", started);
+
+    LevelSummary levels[MAX_LEVELS] = {};
+    u64 cnt = 0;
+    u64 spikes = 0;
+    u64 dropped = 0;
+    f32 spike_max = 0;
+    f64 last_time = 0;
+
+    TelemetryRecord rec = {};
+    while (fread(&rec, sizeof(rec), 1, file) == 1) {
+        cnt++;
+        last_time = rec.time;
+        if (rec.tpe >= TE_CNT) {
+            fprintf(stderr, "%s: record %llu has unknown type %u\n", path, (unsigned long long) cnt, rec.tpe);
+            continue;
+        }
+
+        if (summary_only == false) {
+            printf("%10.1f  %-13s  level %3d  value %9.2f  at %8.1f %8.1f\n",
+                rec.time, telemetry_event_names[rec.tpe], rec.level, rec.value, rec.x, rec.y);
+        }
+
+        if (rec.tpe == TE_FRAME_SPIKE) {
+            spikes++;
+            spike_max = rec.value > spike_max ? rec.value : spike_max;
+        }
+        else if (rec.tpe == TE_DROPPED) {
+            dropped += (u64) rec.value;
+        }
+        if (rec.level < 0 || rec.level >= MAX_LEVELS) {
+            continue;
+        }
+
+        LevelSummary *level = levels + rec.level;
+        if (rec.tpe == TE_LEVEL_ENTER) {
+            level->enters++;
+        }
+        else if (rec.tpe == TE_LEVEL_EXIT) {
+            if (level->exits == 0 || rec.value < level->exit_ms_best) {
+                level->exit_ms_best = rec.value;
+            }
+            level->exits++;
+            level->exit_ms_sum += rec.value;
+        }
+        else if (rec.tpe == TE_FALL) {
+            level->falls++;
+        }
+        else if (rec.tpe == TE_JUMP) {
+            level->jumps++;
+        }
+    }
+    fclose(file);
+
+    printf("\n%llu records over %.1f s, %llu frame spikes (worst %.2f ms), %llu records dropped\n",
+        (unsigned long long) cnt, last_time / 1000, (unsigned long long) spikes, spike_max, (unsigned long long) dropped);
+    printf("level  enters  exits  falls  jumps  mean exit ms  best exit ms\n");
+    for (s32 i = 0; i < MAX_LEVELS; ++i) {
+        LevelSummary *level = levels + i;
+        if (level->enters == 0) {
+            continue;
+        }
+        f64 mean = level->exits ? level->exit_ms_sum / level->exits : 0;
+        printf("%5d  %6d  %5d  %5d  %5d  %12.1f  %12.1f\n", i, level->enters, level->exits, level->falls, level->jumps, mean, level->exit_ms_best);
+    }
+
+    return 0;
+}
@@ -0,0 +1,253 @@
+// Queries a tick trace written with CATJUMP_TRACE set.
+//
+//   catjump_trace info <trace>
+//   catjump_trace snaps <trace> [-n <max>]
+//   catjump_trace find <trace> <column> <op> <value> [-n <max>] [-c]
+//
+// info summarizes the trace. snaps lists every tick where landing snapped anchor.y
+// onto a platform, with the vertical speed the cat came in with. find lists the ticks
+// where a column compares to a value; op is one of lt le gt ge eq ne and, where and
+// tests bits, for the coll column. -n stops after max ticks, -c only counts.
+//
+// Queries walk only the columns they need, in place in the mapped file.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "trace.h"
+#include "pacing.h"
+
+
+enum FindOp {
+    OP_LT,
+    OP_LE,
+    OP_GT,
+    OP_GE,
+    OP_EQ,
+    OP_NE,
+    OP_AND,
+
+    OP_CNT,
+};
+
+const char *op_names[OP_CNT] = { "lt", "le", "gt", "ge", "eq", "ne", "and" };
+
+const char *state_names[] = { "idle", "run", "jump", "fall" };
+
+struct Query {
+    s32 column;
+    FindOp op;
+    f64 value;
+    u64 max;
+    bool count_only;
+};
+
+void PrintTick(const TraceChunk *chunk, u32 i) {
+    u8 state = chunk->state[i];
+    printf("%10llu  level %3d  %-5s frame %2u  x %8.2f  y %9.2f  vx %7.3f  vy %7.3f  coll %c%c%c%c  dt %.2f\n",
+        (unsigned long long) (chunk->header.first_tick + i), chunk->level[i], state < 4 ? state_names[state] : "?", chunk->frame_idx[i],
+        chunk->anchor_x[i], chunk->anchor_y[i], chunk->velocity_x[i], chunk->velocity_y[i],
+        chunk->coll[i] & TRACE_COLL_PLATFORM ? 'P' : '-', chunk->coll[i] & TRACE_COLL_SNAP ? 'S' : '-',
+        chunk->coll[i] & TRACE_COLL_WALL ? 'W' : '-', chunk->coll[i] & TRACE_COLL_PORTAL ? 'E' : '-', chunk->dt[i]);
+}
+
+// indices in [0, cnt) where pred holds go to hits, without a branch per tick;
+// returns how many
+template<typename T, typename F>
+u32 ScanWith(const T *col, u32 cnt, F pred, u32 *hits) {
+    u32 hit_cnt = 0;
+    for (u32 i = 0; i < cnt; ++i) {
+        hits[hit_cnt] = i;
+        hit_cnt += pred(col[i]);
+    }
+    return hit_cnt;
+}
+
+template<typename T>
+u32 ScanColumn(const T *col, u32 cnt, FindOp op, f64 value, u32 *hits) {
+    T v = (T) value;
+    u64 mask = (u64) value;
+    switch (op) {
+        case OP_LT: return ScanWith(col, cnt, [v](T x) { return x < v; }, hits);
+        case OP_LE: return ScanWith(col, cnt, [v](T x) { return x <= v; }, hits);
+        case OP_GT: return ScanWith(col, cnt, [v](T x) { return x > v; }, hits);
+        case OP_GE: return ScanWith(col, cnt, [v](T x) { return x >= v; }, hits);
+        case OP_EQ: return ScanWith(col, cnt, [v](T x) { return x == v; }, hits);
+        case OP_NE: return ScanWith(col, cnt, [v](T x) { return x != v; }, hits);
+        case OP_AND: return ScanWith(col, cnt, [mask](T x) { return ((u64) x & mask) != 0; }, hits);
+        default: return 0;
+    }
+}
+
+u64 Find(TraceFile *tf, Query q) {
+    static u32 hits[TRACE_CHUNK_TICKS];
+    const TraceColumnDesc *desc = tf->header->columns + q.column;
+
+    u64 found = 0;
+    for (u32 c = 0; c < tf->chunk_cnt && found < q.max; ++c) {
+        const TraceChunk *chunk = TraceGetChunk(tf, c);
+        const u8 *col = (const u8*) chunk + desc->offset;
+        u32 cnt = chunk->header.tick_cnt;
+
+        u32 hit_cnt = 0;
+        if (desc->tpe == TT_F32) {
+            hit_cnt = ScanColumn((const f32*) col, cnt, q.op, q.value, hits);
+        }
+        else if (desc->tpe == TT_S16) {
+            hit_cnt = ScanColumn((const s16*) col, cnt, q.op, q.value, hits);
+        }
+        else {
+            hit_cnt = ScanColumn((const u8*) col, cnt, q.op, q.value, hits);
+        }
+
+        for (u32 h = 0; h < hit_cnt && found < q.max; ++h, ++found) {
+            if (q.count_only == false) {
+                PrintTick(chunk, hits[h]);
+            }
+        }
+    }
+    return found;
+}
+
+// snapped landings, with the vertical speed from the tick before
+u64 Snaps(TraceFile *tf, u64 max) {
+    u64 found = 0;
+    f32 vy_before = 0;
+    for (u32 c = 0; c < tf->chunk_cnt && found < max; ++c) {
+        const TraceChunk *chunk = TraceGetChunk(tf, c);
+        u32 cnt = chunk->header.tick_cnt;
+        for (u32 i = 0; i < cnt && found < max; ++i) {
+            if (chunk->coll[i] & TRACE_COLL_SNAP) {
+                f32 vy_in = i > 0 ? chunk->velocity_y[i - 1] : vy_before;
+                printf("%10llu  level %3d  x %8.2f  y %9.2f  landed at vy %7.3f\n",
+                    (unsigned long long) (chunk->header.first_tick + i), chunk->level[i], chunk->anchor_x[i], chunk->anchor_y[i], vy_in);
+                found++;
+            }
+        }
+        vy_before = cnt ? chunk->velocity_y[cnt - 1] : vy_before;
+    }
+    return found;
+}
+
+void Info(TraceFile *tf) {
+    u64 states[256] = {};
+    u64 colls[4] = {};
+    f64 time_ms = 0;
+    s32 level_lo = 0;
+    s32 level_hi = -1;
+
+    for (u32 c = 0; c < tf->chunk_cnt; ++c) {
+        const TraceChunk *chunk = TraceGetChunk(tf, c);
+        for (u32 i = 0; i < chunk->header.tick_cnt; ++i) {
+            states[chunk->state[i]]++;
+            for (s32 b = 0; b < 4; ++b) {
+                colls[b] += (chunk->coll[i] >> b) & 1;
+            }
+            time_ms += chunk->dt[i];
+            s32 level = chunk->level[i];
+            if (level_hi < level_lo) {
+                level_lo = level_hi = level;
+            }
+            level_lo = level < level_lo ? level : level_lo;
+            level_hi = level > level_hi ? level : level_hi;
+        }
+    }
+
+    printf("%llu ticks in %u chunks, %.1f s of game time, levels %d to %d\n",
+        (unsigned long long) tf->tick_cnt, tf->chunk_cnt, time_ms / 1000, level_lo, level_hi);
+    printf("columns:");
+    for (u32 i = 0; i < tf->header->column_cnt; ++i) {
+        printf(" %s", tf->header->columns[i].name);
+    }
+    printf("\nstates:");
+    for (s32 i = 0; i < 4; ++i) {
+        printf(" %s %llu", state_names[i], (unsigned long long) states[i]);
+    }
+    printf("\ncoll: platform %llu  snap %llu  wall %llu  portal %llu\n",
+        (unsigned long long) colls[0], (unsigned long long) colls[1], (unsigned long long) colls[2], (unsigned long long) colls[3]);
+}
+
+s32 Usage(const char *name) {
+    fprintf(stderr, "usage: %s info <trace>\n", name);
+    fprintf(stderr, "       %s snaps <trace> [-n <max>]\n", name);
+    fprintf(stderr, "       %s find <trace> <column> <lt|le|gt|ge|eq|ne|and> <value> [-n <max>] [-c]\n", name);
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        return Usage(argv[0]);
+    }
+    const char *cmd = argv[1];
+    const char *path = argv[2];
+
+    Query q = {};
+    q.max = ~(u64) 0;
+    s32 arg = 3;
+    if (strcmp(cmd, "find") == 0) {
+        if (argc < 6) {
+            return Usage(argv[0]);
+        }
+        q.column = -1;
+        for (s32 i = 0; i < TC_CNT; ++i) {
+            if (strcmp(argv[3], trace_columns[i].name) == 0) {
+                q.column = i;
+            }
+        }
+        q.op = OP_CNT;
+        for (s32 i = 0; i < OP_CNT; ++i) {
+            if (strcmp(argv[4], op_names[i]) == 0) {
+                q.op = (FindOp) i;
+            }
+        }
+        if (q.column == -1 || q.op == OP_CNT) {
+            return Usage(argv[0]);
+        }
+        q.value = atof(argv[5]);
+        arg = 6;
+    }
+    for (; arg < argc; ++arg) {
+        if (strcmp(argv[arg], "-n") == 0 && arg + 1 < argc) {
+            q.max = strtoull(argv[++arg], NULL, 10);
+        }
+        else if (strcmp(argv[arg], "-c") == 0) {
+            q.count_only = true;
+        }
+        else {
+            return Usage(argv[0]);
+        }
+    }
+
+    TraceFile tf = {};
+    if (TraceOpen(&tf, path) == false) {
+        fprintf(stderr, "%s: cannot open, or not a trace of this version\n", path);
+        return 1;
+    }
+
+    f64 t0 = PacerNow();
+    u64 found = 0;
+    if (strcmp(cmd, "info") == 0) {
+        Info(&tf);
+    }
+    else if (strcmp(cmd, "snaps") == 0) {
+        found = Snaps(&tf, q.max);
+    }
+    else if (strcmp(cmd, "find") == 0) {
+        found = Find(&tf, q);
+    }
+    else {
+        TraceClose(&tf);
+        return Usage(argv[0]);
+    }
+
+    if (strcmp(cmd, "info") != 0) {
+        if (q.count_only) {
+            printf("%llu\n", (unsigned long long) found);
+        }
+        fprintf(stderr, "%llu of %llu ticks in %.1f ms\n", (unsigned long long) found, (unsigned long long) tf.tick_cnt, PacerNow() - t0);
+    }
+
+    TraceClose(&tf);
+    return 0;
+}